@@ -0,0 +1,298 @@
+// minnesav@gmail.com
+
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "tree.hpp"
+#include "tree_printer.hpp"
+
+// Benchmark harness: every Tree traversal, build and export path on chains, stars and
+// complete K-ary trees of 10^3 to 10^7 nodes. Each case gets warm-up runs, then timed
+// repetitions (untimed setup before each) until the repetition count or the time budget
+// is used up. Results are one row per case with median, p99 and ns per node.
+
+struct BenchOptions {
+    size_t min_size = 1000;
+    size_t max_size = 10000000;
+    size_t warmup = 1;
+    size_t repetitions = 10;
+    double budget_ms = 2000;  // Stop repeating a case once this much time went into it (after 3 runs)
+    bool json = false;
+    std::string output;  // Empty for stdout
+    std::string scratch = "/tmp";  // Directory for export files
+};
+
+struct BenchResult {
+    std::string shape;
+    size_t size;
+    std::string operation;
+    size_t units;  // Nodes (or operations) handled per repetition
+    size_t repetitions;
+    double median_ns;
+    double p99_ns;
+};
+
+// Keeps the compiler from discarding traversal results
+static volatile long long sink;
+
+static long long valueOf(const Node<int>* node) { return node->value; }
+static long long valueOf(int value) { return value; }
+
+// Walk an iterator range; returns the number of nodes visited
+template <typename Iterator, typename End>
+static size_t scan(Iterator it, End end) {
+    size_t count = 0;
+    long long sum = 0;
+    for (; it != end; ++it) {
+        sum += valueOf(*it);
+        ++count;
+    }
+    sink = sum;
+    return count;
+}
+
+// Nearest-rank percentile of sorted samples
+static double percentile(const std::vector<double>& sorted, double p) {
+    size_t rank = static_cast<size_t>(p * static_cast<double>(sorted.size()) + 0.999999);
+    return sorted[std::min(sorted.size(), std::max<size_t>(rank, 1)) - 1];
+}
+
+// Time run() after warm-up; setup() runs untimed before every run
+static BenchResult measure(const BenchOptions& options, const std::function<void()>& setup,
+                           const std::function<size_t()>& run) {
+    typedef std::chrono::steady_clock Clock;
+    BenchResult result = BenchResult();
+    for (size_t i = 0; i < options.warmup; ++i) {
+        setup();
+        result.units = run();
+    }
+    std::vector<double> samples;
+    double spent_ms = 0;
+    while (samples.size() < std::max<size_t>(options.repetitions, 1)) {
+        setup();
+        Clock::time_point start = Clock::now();
+        result.units = run();
+        double ns = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count());
+        samples.push_back(ns);
+        spent_ms += ns / 1e6;
+        if (samples.size() >= 3 && spent_ms > options.budget_ms) break;
+    }
+    std::sort(samples.begin(), samples.end());
+    result.repetitions = samples.size();
+    result.median_ns = percentile(samples, 0.5);
+    result.p99_ns = percentile(samples, 0.99);
+    return result;
+}
+
+// Build a shape in a forest, which serves as the template every timed tree is restored from
+template <int K>
+static typename Forest<int, K>::Handle buildShape(Forest<int, K>& forest, size_t n,
+                                                  const std::function<size_t(size_t)>& parent_of) {
+    std::vector<Node<int>*> nodes(n);
+    for (size_t i = 0; i < n; ++i) {
+        nodes[i] = new Node<int>(static_cast<int>(i + 1));  // Values are BFS positions, so all distinct
+        if (i > 0) nodes[parent_of(i)]->add_child(nodes[i]);
+    }
+    typename Forest<int, K>::Handle root = forest.copy_tree(nodes[0]);
+    for (Node<int>* node : nodes) {
+        delete node;
+    }
+    return root;
+}
+
+template <int K>
+static void benchShape(const std::string& shape, size_t n, const std::function<size_t(size_t)>& parent_of,
+                       const BenchOptions& options, std::vector<BenchResult>& results) {
+    Forest<int, K> source;
+    typename Forest<int, K>::Handle root = buildShape<K>(source, n, parent_of);
+    Tree<int, K> tree;
+    tree.restore(source, root);
+
+    auto nothing = []() {};
+    auto rebuild = [&]() { tree.restore(source, root); };
+    auto record = [&](const std::string& operation, BenchResult result) {
+        result.shape = shape;
+        result.size = n;
+        result.operation = operation;
+        results.push_back(result);
+        std::cerr << shape << " " << n << " " << operation << ": " << result.median_ns / 1e6 << " ms" << std::endl;
+    };
+
+    // Iterators
+    record("pre_order", measure(options, nothing, [&]() { return scan(tree.begin_pre_order(), tree.end_pre_order()); }));
+    record("post_order", measure(options, nothing, [&]() { return scan(tree.begin_post_order(), tree.end_post_order()); }));
+    record("in_order", measure(options, nothing, [&]() { return scan(tree.begin_in_order(), tree.end_in_order()); }));
+    record("bfs_scan", measure(options, nothing, [&]() { return scan(tree.begin_bfs_scan(), tree.end_bfs_scan()); }));
+    record("dfs_scan", measure(options, nothing, [&]() { return scan(tree.begin_dfs_scan(), tree.end_dfs_scan()); }));
+    record("stackless_pre_order", measure(options, nothing, [&]() {
+        return scan(tree.begin_stackless_pre_order(), tree.end_stackless_pre_order());
+    }));
+    record("stackless_post_order", measure(options, nothing, [&]() {
+        return scan(tree.begin_stackless_post_order(), tree.end_stackless_post_order());
+    }));
+    record("stackless_in_order", measure(options, nothing, [&]() {
+        return scan(tree.begin_stackless_in_order(), tree.end_stackless_in_order());
+    }));
+    record("stackless_dfs_scan", measure(options, nothing, [&]() {
+        return scan(tree.begin_stackless_dfs_scan(), tree.end_stackless_dfs_scan());
+    }));
+    record("best_first", measure(options, nothing, [&]() {
+        return scan(tree.begin_best_first([](const Node<int>* node) { return node->value; }), tree.end_best_first());
+    }));
+    record("heap", measure(options, nothing, [&]() { return scan(tree.begin_heap(), tree.end_heap()); }));
+    record("for_each_pre", measure(options, nothing, [&]() {
+        size_t count = 0;
+        tree.template for_each<Order::Pre>([&count](Node<int>*) { ++count; });
+        return count;
+    }));
+    record("for_each_post", measure(options, nothing, [&]() {
+        size_t count = 0;
+        tree.template for_each<Order::Post>([&count](Node<int>*) { ++count; });
+        return count;
+    }));
+    record("for_each_in", measure(options, nothing, [&]() {
+        size_t count = 0;
+        tree.template for_each<Order::In>([&count](Node<int>*) { ++count; });
+        return count;
+    }));
+    record("for_each_level", measure(options, nothing, [&]() {
+        size_t count = 0;
+        tree.template for_each<Order::Level>([&count](Node<int>*) { ++count; });
+        return count;
+    }));
+
+    // Build: one add_sub_node under the last BFS node (a leaf in every shape). The parent is found
+    // untimed, so this is the insertion plus the summary refresh along the path to the root.
+    int leaf_value = static_cast<int>(n);
+    int next_value = static_cast<int>(n) + 1;
+    Node<int>* leaf = nullptr;
+    record("add_sub_node", measure(options, [&]() {
+        leaf = tree.find(tree.getRoot(), leaf_value);
+        while (!leaf->children.empty()) tree.erase(leaf->children.back());
+    }, [&]() -> size_t {
+        tree.add_sub_node(leaf, next_value);
+        return 1;
+    }));
+    // The value overload searches for the parent first, so this one also pays a find() over the tree
+    record("add_sub_node_by_value", measure(options, [&]() {
+        leaf = tree.find(tree.getRoot(), leaf_value);
+        while (!leaf->children.empty()) tree.erase(leaf->children.back());
+    }, [&]() -> size_t {
+        Node<int> parent(leaf_value);
+        Node<int> child(next_value);
+        tree.add_sub_node(parent, child);
+        return 1;
+    }));
+    record("restore", measure(options, nothing, [&]() { rebuild(); return n; }));
+
+    // Search: values spread evenly over BFS order
+    record("find", measure(options, nothing, [&]() -> size_t {
+        const size_t lookups = 8;
+        long long found = 0;
+        for (size_t j = 1; j <= lookups; ++j) {
+            Node<int>* node = tree.find(tree.getRoot(), static_cast<int>(n * j / lookups));
+            found += node ? node->value : 0;
+        }
+        sink = found;
+        return lookups;
+    }));
+
+    record("myHeap", measure(options, rebuild, [&]() { tree.myHeap(); return n; }));
+    record("clear", measure(options, rebuild, [&]() { tree.clear(); return n; }));
+    rebuild();
+
+    // Export
+    TreePrinter<int, K> printer;
+    printer.set_dot_only(true);
+    std::string dot_path = options.scratch + "/tree_bench.dot";
+    std::string svg_path = options.scratch + "/tree_bench.svg";
+    record("write_dot", measure(options, nothing, [&]() { printer.write_dot(tree, dot_path); return n; }));
+    record("print_svg", measure(options, nothing, [&]() { printer.print_svg(tree, svg_path); return n; }));
+    std::remove(dot_path.c_str());
+    std::remove(svg_path.c_str());
+}
+
+static void writeResults(std::ostream& out, const std::vector<BenchResult>& results, bool json) {
+    if (json) {
+        out << "[\n";
+        for (size_t i = 0; i < results.size(); ++i) {
+            const BenchResult& r = results[i];
+            out << "  {\"shape\": \"" << r.shape << "\", \"size\": " << r.size << ", \"operation\": \"" << r.operation
+                << "\", \"units\": " << r.units << ", \"repetitions\": " << r.repetitions
+                << ", \"median_ns\": " << r.median_ns << ", \"p99_ns\": " << r.p99_ns
+                << ", \"ns_per_unit\": " << (r.units ? r.median_ns / static_cast<double>(r.units) : 0.0) << "}"
+                << (i + 1 < results.size() ? "," : "") << "\n";
+        }
+        out << "]\n";
+    } else {
+        out << "shape,size,operation,units,repetitions,median_ns,p99_ns,ns_per_unit\n";
+        for (const BenchResult& r : results) {
+            out << r.shape << "," << r.size << "," << r.operation << "," << r.units << "," << r.repetitions << ","
+                << r.median_ns << "," << r.p99_ns << ","
+                << (r.units ? r.median_ns / static_cast<double>(r.units) : 0.0) << "\n";
+        }
+    }
+}
+
+static void runBenchmarks(const BenchOptions& options) {
+    std::vector<BenchResult> results;
+    for (size_t n = options.min_size; n <= options.max_size; n *= 10) {
+        benchShape<2>("chain", n, [](size_t i) { return i - 1; }, options, results);
+        benchShape<INT_MAX>("star", n, [](size_t) { return size_t(0); }, options, results);
+        benchShape<2>("complete_2", n, [](size_t i) { return (i - 1) / 2; }, options, results);
+        benchShape<3>("complete_3", n, [](size_t i) { return (i - 1) / 3; }, options, results);
+    }
+    if (options.output.empty()) {
+        writeResults(std::cout, results, options.json);
+    } else {
+        std::ofstream out(options.output.c_str());
+        writeResults(out, results, options.json);
+    }
+}
+
+static void usage(const char* program) {
+    std::cerr << "Usage: " << program << " [--min-size N] [--max-size N] [--warmup N] [--repetitions N]"
+              << " [--budget-ms MS] [--json] [--output PATH] [--scratch DIR]" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    BenchOptions options;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--json") {
+            options.json = true;
+        } else if (arg == "--min-size" && has_value) {
+            options.min_size = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--max-size" && has_value) {
+            options.max_size = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--warmup" && has_value) {
+            options.warmup = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--repetitions" && has_value) {
+            options.repetitions = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--budget-ms" && has_value) {
+            options.budget_ms = std::strtod(argv[++i], nullptr);
+        } else if (arg == "--output" && has_value) {
+            options.output = argv[++i];
+        } else if (arg == "--scratch" && has_value) {
+            options.scratch = argv[++i];
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (options.min_size < 2) {
+        usage(argv[0]);
+        return 1;
+    }
+    runBenchmarks(options);
+    return 0;
+}
@@ -0,0 +1,184 @@
+// minnesav@gmail.com
+
+#ifndef BUFFERED_WRITER_HPP
+#define BUFFERED_WRITER_HPP
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <sstream>
+#include <vector>
+#include <stdexcept>
+#include <type_traits>
+
+/**
+ * @brief Output file with one large user-space buffer and hand-rolled value formatting.
+ *
+ * Base class of the DOT and SVG exporters: values are escaped for the target format
+ * (DOT string or XML text) and numbers are formatted without stream machinery.
+ *
+ * @tparam T The type of the values written as labels.
+ */
+template <typename T>
+class BufferedWriter {
+public:
+    // How label text is escaped
+    enum class Escape {
+        Dot,  // Backslash before quotes and backslashes
+        Xml   // Entities for &, <, > and quotes
+    };
+
+    /**
+     * @brief Opens the output file for writing.
+     *
+     * @param filename The path of the output file.
+     * @param escape_mode How label text is escaped.
+     * @param buffer_size The size of the output buffer in bytes.
+     */
+    BufferedWriter(const std::string& filename, Escape escape_mode, size_t buffer_size = 1 << 20)
+        : file(std::fopen(filename.c_str(), "wb")), buffer(buffer_size < 64 ? 64 : buffer_size), used(0),
+          escape(escape_mode) {
+        if (!file) {
+            throw std::runtime_error("Could not open file to write " + filename + ".");
+        }
+    }
+
+    /**
+     * @brief Flushes any buffered output and closes the file.
+     */
+    ~BufferedWriter() {
+        std::fwrite(buffer.data(), 1, used, file);  // Best effort; writers drain() when they finish normally
+        std::fclose(file);
+    }
+
+    BufferedWriter(const BufferedWriter&) = delete;
+    BufferedWriter& operator=(const BufferedWriter&) = delete;
+
+protected:
+    void put(char c) {
+        if (used == buffer.size()) drain();
+        buffer[used++] = c;
+    }
+
+    void put(const char* text) {
+        put(text, std::strlen(text));
+    }
+
+    void put(const char* text, size_t length) {
+        if (length > buffer.size() - used) {
+            drain();
+            if (length > buffer.size()) {
+                writeRaw(text, length);
+                return;
+            }
+        }
+        std::memcpy(&buffer[used], text, length);
+        used += length;
+    }
+
+    // Decimal formatting without locale or stream machinery (to_chars-style)
+    void putNumber(unsigned long long number) {
+        char digits[20];
+        size_t count = 0;
+        do {
+            digits[count++] = static_cast<char>('0' + number % 10);
+            number /= 10;
+        } while (number);
+        if (count > buffer.size() - used) drain();
+        while (count) {
+            buffer[used++] = digits[--count];
+        }
+    }
+
+    // Fixed-point coordinate with one decimal, without snprintf
+    void putFixed(double number) {
+        if (number < 0) {
+            put('-');
+            number = -number;
+        }
+        unsigned long long tenths = static_cast<unsigned long long>(number * 10.0 + 0.5);
+        putNumber(tenths / 10);
+        put('.');
+        put(static_cast<char>('0' + tenths % 10));
+    }
+
+    // The value as label text, escaped for the output format
+    void putValue(const T& value) {
+        putValue(value, ValueKind());
+    }
+
+    void drain() {
+        writeRaw(buffer.data(), used);
+        used = 0;
+    }
+
+private:
+    std::FILE* file;
+    std::vector<char> buffer;
+    size_t used;
+    Escape escape;
+    std::ostringstream scratch;  // Reused for values that only support operator<<
+
+    // 0: integer, 1: floating point, 2: std::string, 3: anything with operator<<
+    typedef std::integral_constant<int,
+        std::is_integral<T>::value && !std::is_same<T, char>::value && !std::is_same<T, bool>::value ? 0 :
+        std::is_floating_point<T>::value ? 1 :
+        std::is_same<T, std::string>::value ? 2 : 3> ValueKind;
+
+    void putValue(const T& value, std::integral_constant<int, 0>) {
+        if (isNegative(value, std::is_signed<T>())) {
+            put('-');
+            putNumber(0ULL - static_cast<unsigned long long>(value));
+        } else {
+            putNumber(static_cast<unsigned long long>(value));
+        }
+    }
+
+    static bool isNegative(const T& value, std::true_type) { return value < 0; }
+    static bool isNegative(const T&, std::false_type) { return false; }
+
+    void putValue(const T& value, std::integral_constant<int, 1>) {
+        char text[32];
+        int length = std::snprintf(text, sizeof(text), "%g", static_cast<double>(value));  // Same as operator<< defaults
+        put(text, static_cast<size_t>(length));
+    }
+
+    void putValue(const T& value, std::integral_constant<int, 2>) {
+        putEscaped(value.data(), value.size());
+    }
+
+    void putValue(const T& value, std::integral_constant<int, 3>) {
+        scratch.str(std::string());
+        scratch << value;
+        const std::string& text = scratch.str();
+        putEscaped(text.data(), text.size());
+    }
+
+    void putEscaped(const char* text, size_t length) {
+        for (size_t i = 0; i < length; ++i) {
+            char c = text[i];
+            if (escape == Escape::Dot) {
+                if (c == '"' || c == '\\') put('\\');
+                put(c);
+            } else if (c == '&') {
+                put("&amp;");
+            } else if (c == '<') {
+                put("&lt;");
+            } else if (c == '>') {
+                put("&gt;");
+            } else if (c == '"') {
+                put("&quot;");
+            } else {
+                put(c);
+            }
+        }
+    }
+
+    void writeRaw(const char* data, size_t length) {
+        if (length && std::fwrite(data, 1, length, file) != length) {
+            throw std::runtime_error("Could not write output file.");
+        }
+    }
+};
+
+#endif // BUFFERED_WRITER_HPP
@@ -5,6 +5,7 @@
 
 #include <iostream>
 #include <cmath>
+#include <functional>
 
 using namespace std;
 
@@ -97,9 +98,17 @@ public:
     }
 };
 
-#endif // COMPLEX_HPP
+/**
+ * @brief Hash specialisation so Complex values can be used as keys (e.g. by Tree::compress).
+ */
+namespace std {
+template <>
+struct hash<Complex> {
+    size_t operator()(const Complex& c) const {
+        size_t h = hash<double>()(c.real);
+        return h ^ (hash<double>()(c.imag) + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2));
+    }
+};
+}
 
 #endif // COMPLEX_HPP
-
-
-
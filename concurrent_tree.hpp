@@ -0,0 +1,508 @@
+// minnesav@gmail.com
+
+#ifndef CONCURRENT_TREE_HPP
+#define CONCURRENT_TREE_HPP
+
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <new>
+#include <vector>
+#include <queue>
+#include <algorithm>
+#include <stdexcept>
+#include "epoch_reclaimer.hpp"
+
+/**
+ * @brief A node of a ConcurrentTree whose child list readers can follow without locks.
+ *
+ * The value never changes once the node is published. Children live in a fixed K-slot
+ * list: an appender reserves a slot by raising the count with a compare-and-swap (which
+ * also enforces K), then stores the child in it (release). A reader may briefly see a
+ * reserved slot that is still empty and skips it. Removing a child publishes a whole
+ * new list instead of editing the one readers may be walking.
+ *
+ * @tparam T The type of the value stored in the node.
+ * @tparam K The maximum number of children.
+ */
+template <typename T, int K>
+class ConcurrentNode {
+public:
+    struct ChildList {
+        std::atomic<size_t> count;
+        std::atomic<ConcurrentNode*> slots[K];
+
+        ChildList() : count(0) {
+            for (auto& slot : slots) slot.store(nullptr, std::memory_order_relaxed);
+        }
+    };
+
+    const T value;
+
+    explicit ConcurrentNode(const T& val) : value(val), kids(&inline_kids), pooled(false) {}
+
+    ~ConcurrentNode() {
+        ChildList* list = kids.load(std::memory_order_relaxed);
+        if (list != &inline_kids) delete list;
+    }
+
+    ConcurrentNode(const ConcurrentNode&) = delete;
+    ConcurrentNode& operator=(const ConcurrentNode&) = delete;
+
+    /**
+     * @brief Number of reserved child slots (a slot being filled right now reads as nullptr).
+     */
+    size_t child_count() const {
+        return kids.load(std::memory_order_acquire)->count.load(std::memory_order_acquire);
+    }
+
+    /**
+     * @brief The i-th child, for i < child_count(), or nullptr while it is still being stored.
+     */
+    const ConcurrentNode* child(size_t i) const {
+        return kids.load(std::memory_order_acquire)->slots[i].load(std::memory_order_acquire);
+    }
+
+    /**
+     * @brief Calls f on every published child, in order, from one consistent child list.
+     */
+    template <typename F>
+    void for_each_child(F f) const {
+        const ChildList* list = kids.load(std::memory_order_acquire);
+        size_t count = list->count.load(std::memory_order_acquire);
+        for (size_t i = 0; i < count; ++i) {
+            const ConcurrentNode* next = list->slots[i].load(std::memory_order_acquire);
+            if (next) f(next);
+        }
+    }
+
+private:
+    template <typename, int> friend class ConcurrentTree;
+
+    std::atomic<ChildList*> kids;  // Current child list (inline_kids until a child is removed)
+    ChildList inline_kids;
+    bool pooled;  // Lives in a builder's NodeArena rather than on the heap
+};
+
+/**
+ * @brief Per-thread bump allocator for the nodes created by one ConcurrentTree::Builder.
+ *
+ * Only its owning thread allocates from it, so allocation needs no synchronisation.
+ * Memory goes back in whole chunks when the tree is destroyed.
+ *
+ * @tparam NodeType The node type to allocate.
+ */
+template <typename NodeType>
+class NodeArena {
+public:
+    explicit NodeArena(size_t chunk_nodes = 1024) : chunk_nodes(chunk_nodes), used(chunk_nodes), created(0) {}
+
+    ~NodeArena() {
+        for (char* chunk : chunks) {
+            ::operator delete(chunk);
+        }
+    }
+
+    NodeArena(const NodeArena&) = delete;
+    NodeArena& operator=(const NodeArena&) = delete;
+
+    /**
+     * @brief Raw storage for one node.
+     */
+    void* allocate() {
+        if (used == chunk_nodes) {
+            chunks.push_back(static_cast<char*>(::operator new(chunk_nodes * sizeof(NodeType))));
+            used = 0;
+        }
+        return chunks.back() + sizeof(NodeType) * used++;
+    }
+
+    /**
+     * @brief Nodes created through this arena (read by other threads for ConcurrentTree::size()).
+     */
+    std::atomic<size_t>& count() {
+        return created;
+    }
+
+private:
+    std::vector<char*> chunks;
+    size_t chunk_nodes;
+    size_t used;  // Nodes handed out from the last chunk
+    std::atomic<size_t> created;
+};
+
+/**
+ * @brief A k-ary tree that many threads can read while one thread updates it.
+ *
+ * Readers never lock: a traversal pins an epoch and follows atomically published links.
+ * Children can be appended from any number of threads at once (add_sub_node, or a
+ * Builder per thread for arena allocation). The structural updates (remove, clear,
+ * myHeap, replacing the root) need one writer at a time and no concurrent appends;
+ * what they unlink is retired and freed only after every reader that could still
+ * reach it has finished.
+ *
+ * @tparam T The type of the values stored in the tree nodes.
+ * @tparam K The maximum number of children each node can have.
+ */
+template <typename T, int K = 2>
+class ConcurrentTree {
+public:
+    typedef ConcurrentNode<T, K> NodeType;
+
+    ConcurrentTree() : root(nullptr), count(0) {}
+
+    /**
+     * @brief Frees the tree; no reader or writer may still be using it.
+     */
+    ~ConcurrentTree() {
+        destroy(root.load(std::memory_order_relaxed));
+    }
+
+    ConcurrentTree(const ConcurrentTree&) = delete;
+    ConcurrentTree& operator=(const ConcurrentTree&) = delete;
+
+    /**
+     * @brief Pins the current epoch: nodes reachable now stay valid while the guard lives.
+     */
+    EpochReclaimer::Guard read() {
+        return EpochReclaimer::Guard(reclaimer);
+    }
+
+    /**
+     * @brief The current root; only dereference it while holding a guard from read().
+     */
+    const NodeType* getRoot() const {
+        return root.load(std::memory_order_acquire);
+    }
+
+    /**
+     * @brief Number of nodes (exact once concurrent appends have finished).
+     */
+    size_t size() const {
+        std::lock_guard<std::mutex> lock(arenas_mutex);
+        size_t total = count.load(std::memory_order_relaxed);  // Builder counts are kept apart, modulo 2^64
+        for (const auto& arena : arenas) {
+            total += arena->count().load(std::memory_order_relaxed);
+        }
+        return total;
+    }
+
+    /**
+     * @brief Appends children from one thread, allocating them from that thread's own arena.
+     *
+     * Create one builder per ingest thread; builders on different threads share nothing
+     * but the K-slot counters of the parents they append to.
+     */
+    class Builder {
+    public:
+        /**
+         * @brief Appends a child with the given value to the given parent.
+         *
+         * @return NodeType* The new child.
+         */
+        NodeType* add_sub_node(NodeType* parent, const T& value) {
+            size_t slot = reserveSlot(parent);
+            NodeType* child = new (arena->allocate()) NodeType(value);
+            child->pooled = true;
+            parent->kids.load(std::memory_order_relaxed)->slots[slot].store(child, std::memory_order_release);
+            arena->count().fetch_add(1, std::memory_order_relaxed);
+            return child;
+        }
+
+    private:
+        friend class ConcurrentTree;
+
+        NodeArena<NodeType>* arena;
+
+        explicit Builder(NodeArena<NodeType>* arena) : arena(arena) {}
+    };
+
+    /**
+     * @brief A builder with a fresh arena; use it from a single thread.
+     */
+    Builder builder() {
+        std::lock_guard<std::mutex> lock(arenas_mutex);
+        arenas.push_back(std::unique_ptr<NodeArena<NodeType>>(new NodeArena<NodeType>()));
+        return Builder(arenas.back().get());
+    }
+
+    // Structural updates: one thread at a time
+
+    /**
+     * @brief Adds a root, or replaces the root by a node with the new value and the same children.
+     */
+    NodeType* add_root(const T& value) {
+        NodeType* fresh = new NodeType(value);
+        NodeType* old = root.load(std::memory_order_relaxed);
+        if (old) {
+            typename NodeType::ChildList* list = old->kids.load(std::memory_order_relaxed);
+            size_t children = list->count.load(std::memory_order_relaxed);
+            for (size_t i = 0; i < children; ++i) {
+                fresh->inline_kids.slots[i].store(list->slots[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+            }
+            fresh->inline_kids.count.store(children, std::memory_order_relaxed);
+        } else {
+            count.fetch_add(1, std::memory_order_relaxed);
+        }
+        root.store(fresh, std::memory_order_release);
+        if (old) {
+            reclaimer.retire([old] { delete old; });  // The children now belong to the new root
+            reclaimer.collect();
+        }
+        return fresh;
+    }
+
+    /**
+     * @brief Appends a child with the given value to the given parent; safe from any thread.
+     *
+     * @return NodeType* The new child.
+     */
+    NodeType* add_sub_node(NodeType* parent, const T& value) {
+        size_t slot = reserveSlot(parent);
+        NodeType* child = new NodeType(value);
+        parent->kids.load(std::memory_order_relaxed)->slots[slot].store(child, std::memory_order_release);
+        count.fetch_add(1, std::memory_order_relaxed);
+        return child;
+    }
+
+    /**
+     * @brief Appends a child under the first node (pre-order) holding parent_value.
+     */
+    NodeType* add_sub_node(const T& parent_value, const T& value) {
+        NodeType* parent = find(parent_value);
+        if (!parent) {
+            throw std::runtime_error("Parent node not found or maximum children exceeded.");
+        }
+        return add_sub_node(parent, value);
+    }
+
+    /**
+     * @brief First node in pre-order holding the given value, or nullptr.
+     */
+    NodeType* find(const T& value) {
+        std::vector<NodeType*> stack;
+        if (NodeType* top = root.load(std::memory_order_relaxed)) stack.push_back(top);
+        while (!stack.empty()) {
+            NodeType* node = stack.back();
+            stack.pop_back();
+            if (node->value == value) return node;
+            size_t mark = stack.size();
+            forEachChild(node, [&stack](NodeType* child) { stack.push_back(child); });
+            std::reverse(stack.begin() + static_cast<std::ptrdiff_t>(mark), stack.end());
+        }
+        return nullptr;
+    }
+
+    /**
+     * @brief Unlinks the index-th child of parent; its subtree is freed once readers move on.
+     */
+    void remove(NodeType* parent, size_t index) {
+        typename NodeType::ChildList* old = parent->kids.load(std::memory_order_relaxed);
+        size_t children = old->count.load(std::memory_order_relaxed);
+        if (index >= children) {
+            throw std::runtime_error("No child at the given index.");
+        }
+        typename NodeType::ChildList* list = new typename NodeType::ChildList();
+        size_t kept = 0;
+        for (size_t i = 0; i < children; ++i) {
+            if (i != index) list->slots[kept++].store(old->slots[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+        }
+        list->count.store(kept, std::memory_order_relaxed);
+        NodeType* removed = old->slots[index].load(std::memory_order_relaxed);
+        parent->kids.store(list, std::memory_order_release);
+        count.fetch_sub(subtreeSize(removed), std::memory_order_relaxed);
+        if (old != &parent->inline_kids) {
+            reclaimer.retire([old] { delete old; });
+        }
+        reclaimer.retire([removed] { destroy(removed); });
+        reclaimer.collect();
+    }
+
+    /**
+     * @brief Unlinks the whole tree; its nodes are freed once readers move on.
+     */
+    void clear() {
+        NodeType* old = root.exchange(nullptr, std::memory_order_acq_rel);
+        count.fetch_sub(size(), std::memory_order_relaxed);
+        if (old) reclaimer.retire([old] { destroy(old); });
+        reclaimer.collect();
+    }
+
+    /**
+     * @brief Rebuilds the tree as a min-heap in BFS order (as Tree::myHeap) and swaps it in atomically.
+     */
+    void myHeap() {
+        std::vector<T> values;
+        std::vector<NodeType*> stack;
+        if (NodeType* top = root.load(std::memory_order_relaxed)) stack.push_back(top);
+        while (!stack.empty()) {
+            NodeType* node = stack.back();
+            stack.pop_back();
+            values.push_back(node->value);
+            forEachChild(node, [&stack](NodeType* child) { stack.push_back(child); });
+        }
+        std::sort(values.begin(), values.end());  // Ascending BFS order is a min-heap for any K
+
+        // Built off to the side in BFS order, then published with a single store
+        std::vector<NodeType*> nodes;
+        nodes.reserve(values.size());
+        for (const T& value : values) {
+            nodes.push_back(new NodeType(value));
+        }
+        for (size_t i = 1; i < nodes.size(); ++i) {
+            NodeType* parent = nodes[(i - 1) / K];
+            size_t slot = parent->inline_kids.count.load(std::memory_order_relaxed);
+            parent->inline_kids.slots[slot].store(nodes[i], std::memory_order_relaxed);
+            parent->inline_kids.count.store(slot + 1, std::memory_order_relaxed);
+        }
+        NodeType* old = root.exchange(nodes.empty() ? nullptr : nodes[0], std::memory_order_acq_rel);
+        if (old) reclaimer.retire([old] { destroy(old); });
+        reclaimer.collect();
+    }
+
+    /**
+     * @brief Frees retired nodes that no reader can reach any more.
+     */
+    void collect() {
+        reclaimer.collect();
+    }
+
+    /**
+     * @brief Number of retired nodes or child lists not yet freed.
+     */
+    size_t pending_reclamation() const {
+        return reclaimer.pending();
+    }
+
+    // DFS Iterator (pre-order): pins an epoch for as long as it is traversing
+    class DFSIterator {
+    private:
+        EpochReclaimer::Guard guard;
+        std::vector<const NodeType*> stack;
+
+    public:
+        explicit DFSIterator(ConcurrentTree* tree) {
+            if (!tree) return;
+            guard = tree->read();
+            if (const NodeType* top = tree->getRoot()) stack.push_back(top);
+        }
+
+        bool operator!=(const DFSIterator&) const {
+            return !stack.empty();
+        }
+
+        DFSIterator& operator++() {
+            const NodeType* node = stack.back();
+            stack.pop_back();
+            size_t mark = stack.size();
+            node->for_each_child([this](const NodeType* child) { stack.push_back(child); });
+            std::reverse(stack.begin() + static_cast<std::ptrdiff_t>(mark), stack.end());
+            return *this;
+        }
+
+        const NodeType* operator*() const {
+            return stack.back();
+        }
+
+        const NodeType* operator->() const {
+            return stack.back();
+        }
+    };
+
+    // BFS Iterator: pins an epoch for as long as it is traversing
+    class BFSIterator {
+    private:
+        EpochReclaimer::Guard guard;
+        std::queue<const NodeType*> queue;
+
+    public:
+        explicit BFSIterator(ConcurrentTree* tree) {
+            if (!tree) return;
+            guard = tree->read();
+            if (const NodeType* top = tree->getRoot()) queue.push(top);
+        }
+
+        bool operator!=(const BFSIterator&) const {
+            return !queue.empty();
+        }
+
+        BFSIterator& operator++() {
+            const NodeType* node = queue.front();
+            queue.pop();
+            node->for_each_child([this](const NodeType* child) { queue.push(child); });
+            return *this;
+        }
+
+        const NodeType* operator*() const {
+            return queue.front();
+        }
+
+        const NodeType* operator->() const {
+            return queue.front();
+        }
+    };
+
+    DFSIterator begin_dfs_scan() { return DFSIterator(this); }
+    DFSIterator end_dfs_scan() { return DFSIterator(nullptr); }
+
+    BFSIterator begin_bfs_scan() { return BFSIterator(this); }
+    BFSIterator end_bfs_scan() { return BFSIterator(nullptr); }
+
+private:
+    std::atomic<NodeType*> root;
+    std::atomic<size_t> count;  // Nodes created or removed outside the builders' arenas
+    mutable std::mutex arenas_mutex;  // Guards the arena list, not the arenas
+    std::vector<std::unique_ptr<NodeArena<NodeType>>> arenas;  // Outlive the reclaimer's pending frees
+    EpochReclaimer reclaimer;
+
+    // Take the next free slot of parent's child list, failing once all K are taken
+    static size_t reserveSlot(NodeType* parent) {
+        typename NodeType::ChildList* list = parent->kids.load(std::memory_order_acquire);
+        size_t slot = list->count.load(std::memory_order_relaxed);
+        do {
+            if (slot >= K) {
+                throw std::runtime_error("Parent node not found or maximum children exceeded.");
+            }
+        } while (!list->count.compare_exchange_weak(slot, slot + 1, std::memory_order_acq_rel, std::memory_order_relaxed));
+        return slot;
+    }
+
+    template <typename F>
+    static void forEachChild(NodeType* node, F f) {
+        typename NodeType::ChildList* list = node->kids.load(std::memory_order_acquire);
+        size_t children = list->count.load(std::memory_order_acquire);
+        for (size_t i = 0; i < children; ++i) {
+            NodeType* child = list->slots[i].load(std::memory_order_acquire);
+            if (child) f(child);
+        }
+    }
+
+    static size_t subtreeSize(const NodeType* node) {
+        size_t total = 0;
+        std::vector<const NodeType*> stack(1, node);
+        while (!stack.empty()) {
+            const NodeType* next = stack.back();
+            stack.pop_back();
+            ++total;
+            next->for_each_child([&stack](const NodeType* child) { stack.push_back(child); });
+        }
+        return total;
+    }
+
+    static void destroy(NodeType* node) {
+        std::vector<NodeType*> stack;
+        if (node) stack.push_back(node);
+        while (!stack.empty()) {
+            NodeType* next = stack.back();
+            stack.pop_back();
+            forEachChild(next, [&stack](NodeType* child) { stack.push_back(child); });
+            if (next->pooled) {
+                next->~NodeType();  // The arena keeps the memory until the tree goes away
+            } else {
+                delete next;
+            }
+        }
+    }
+};
+
+#endif // CONCURRENT_TREE_HPP
@@ -0,0 +1,178 @@
+// minnesav@gmail.com
+
+#ifndef DOT_WRITER_HPP
+#define DOT_WRITER_HPP
+
+#include <string>
+#include <vector>
+#include <stack>
+#include <queue>
+#include <limits>
+#include "node.hpp"
+#include "buffered_writer.hpp"
+
+/**
+ * @brief Level-of-detail limits for exporting huge trees.
+ *
+ * Parts of the tree that fall outside the limits are drawn as one box labelled
+ * "+N", where N is the number of nodes it stands for. Subtree sizes come from
+ * Node::size, so the export costs time proportional to what is drawn.
+ */
+struct RenderOptions {
+    size_t max_depth;  // Nodes deeper than this are summarised under their ancestor at this depth
+    size_t collapse_threshold;  // Child subtrees with more nodes than this are drawn as a summary
+    size_t max_nodes;  // Budget of real nodes, filled in breadth-first order
+
+    RenderOptions()
+        : max_depth(std::numeric_limits<size_t>::max()),
+          collapse_threshold(std::numeric_limits<size_t>::max()),
+          max_nodes(std::numeric_limits<size_t>::max()) {}
+
+    /**
+     * @brief Whether no limit is set, i.e. the whole tree is exported.
+     */
+    bool unlimited() const {
+        return max_depth == std::numeric_limits<size_t>::max() &&
+               collapse_threshold == std::numeric_limits<size_t>::max() &&
+               max_nodes == std::numeric_limits<size_t>::max();
+    }
+};
+
+/**
+ * @brief Streams a tree to a DOT file through one large user-space buffer.
+ *
+ * Nodes get index-based identities (n0, n1, ... in pre-order) and carry their value
+ * as a label, so equal values stay distinct graph nodes. The walk is iterative and
+ * numbers are formatted by hand, so export time is linear in the tree size.
+ *
+ * @tparam T The type of the values stored in the tree nodes.
+ * @tparam Summary The summary policy of the nodes (see summary.hpp).
+ */
+template <typename T, typename Summary = StructuralSummary>
+class DotWriter : public BufferedWriter<T> {
+public:
+    /**
+     * @brief Opens the DOT file for writing.
+     *
+     * @param filename The path of the DOT file.
+     * @param buffer_size The size of the output buffer in bytes.
+     */
+    explicit DotWriter(const std::string& filename, size_t buffer_size = 1 << 20)
+        : BufferedWriter<T>(filename, BufferedWriter<T>::Escape::Dot, buffer_size) {}
+
+    /**
+     * @brief Writes the whole DOT graph for the tree rooted at the given node.
+     *
+     * @param root The root of the tree (may be nullptr for an empty graph).
+     */
+    void write(const Node<T, Summary>* root) {
+        this->put("digraph G {\nnode [shape=circle];\n");
+        if (root) {
+            // (node, parent id); the root has no parent
+            struct Frame { const Node<T, Summary>* node; size_t parent; };
+            const size_t none = size_t(-1);
+            std::stack<Frame, std::vector<Frame>> stack;
+            stack.push(Frame{root, none});
+            size_t next_id = 0;
+            while (!stack.empty()) {
+                Frame frame = stack.top();
+                stack.pop();
+                size_t id = next_id++;
+                putNodeLine(id, frame.node->value);
+                if (frame.parent != none) {
+                    putEdge(frame.parent, id);
+                }
+                for (auto it = frame.node->children.rbegin(); it != frame.node->children.rend(); ++it) {
+                    if (*it) stack.push(Frame{*it, id});
+                }
+            }
+        }
+        this->put("}\n");
+        this->drain();
+    }
+
+    /**
+     * @brief Writes a level-of-detail DOT graph honouring the given limits.
+     *
+     * Real nodes are numbered breadth-first so that a node budget keeps the top of
+     * the tree. With no limits set this is the same as write(root).
+     *
+     * @param root The root of the tree (may be nullptr for an empty graph).
+     * @param options The depth, collapse and node-budget limits.
+     */
+    void write(const Node<T, Summary>* root, const RenderOptions& options) {
+        if (options.unlimited()) {
+            write(root);
+            return;
+        }
+        this->put("digraph G {\nnode [shape=circle];\n");
+        if (root) {
+            struct Entry { const Node<T, Summary>* node; size_t id; size_t depth; };
+            std::queue<Entry> queue;
+            size_t next_id = 0;
+            size_t drawn = 1;
+            putNodeLine(next_id, root->value);
+            queue.push(Entry{root, next_id++, 0});
+            while (!queue.empty()) {
+                Entry entry = queue.front();
+                queue.pop();
+                if (entry.node->children.empty()) continue;
+                if (entry.depth >= options.max_depth) {
+                    putSummary(entry.id, next_id++, entry.node->size - 1);
+                    continue;
+                }
+                size_t hidden = 0;  // Nodes left out once the budget is spent
+                for (const Node<T, Summary>* child : entry.node->children) {
+                    if (!child) continue;
+                    if (drawn >= options.max_nodes) {
+                        hidden += child->size;
+                    } else if (child->size > options.collapse_threshold) {
+                        putSummary(entry.id, next_id++, child->size);
+                    } else {
+                        size_t id = next_id++;
+                        putNodeLine(id, child->value);
+                        putEdge(entry.id, id);
+                        queue.push(Entry{child, id, entry.depth + 1});
+                        ++drawn;
+                    }
+                }
+                if (hidden) {
+                    putSummary(entry.id, next_id++, hidden);
+                }
+            }
+        }
+        this->put("}\n");
+        this->drain();
+    }
+
+private:
+    // Emit `n<id> [label="<value>"];`
+    void putNodeLine(size_t id, const T& value) {
+        this->put('n');
+        this->putNumber(id);
+        this->put(" [label=\"");
+        this->putValue(value);
+        this->put("\"];\n");
+    }
+
+    // Emit a `+<count>` box standing for `count` hidden nodes under `parent`
+    void putSummary(size_t parent, size_t id, size_t count) {
+        this->put('n');
+        this->putNumber(id);
+        this->put(" [label=\"+");
+        this->putNumber(count);
+        this->put("\", shape=box];\n");
+        putEdge(parent, id);
+    }
+
+    // Emit `n<from> -> n<to>;`
+    void putEdge(size_t from, size_t to) {
+        this->put('n');
+        this->putNumber(from);
+        this->put(" -> n");
+        this->putNumber(to);
+        this->put(";\n");
+    }
+};
+
+#endif // DOT_WRITER_HPP
@@ -0,0 +1,164 @@
+// minnesav@gmail.com
+
+#ifndef EPOCH_RECLAIMER_HPP
+#define EPOCH_RECLAIMER_HPP
+
+#include <cstdint>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <functional>
+#include <stdexcept>
+
+/**
+ * @brief Epoch-based reclamation: frees memory only once no reader can still be looking at it.
+ *
+ * A reader pins the current epoch for the duration of a traversal. Writers unlink an
+ * object first and then retire() it, tagged with the epoch at that moment. collect()
+ * advances the epoch and frees everything retired before the oldest pinned epoch.
+ * Pinning is a single compare-and-swap on a slot picked from the thread id, so
+ * readers on different cores do not share cache lines with each other or the writer.
+ * At most max_readers guards can be live at once; pinning throws when every slot
+ * stays taken.
+ */
+class EpochReclaimer {
+public:
+    static const size_t max_readers = 64;  // Readers pinned at the same time
+
+    /**
+     * @brief Keeps the epoch it pinned until destroyed; objects it can reach stay alive.
+     */
+    class Guard {
+    public:
+        Guard() : slot(nullptr) {}
+
+        explicit Guard(EpochReclaimer& owner) : slot(owner.pin()) {}
+
+        Guard(Guard&& other) : slot(other.slot) {
+            other.slot = nullptr;
+        }
+
+        Guard& operator=(Guard&& other) {
+            if (this != &other) {
+                release();
+                slot = other.slot;
+                other.slot = nullptr;
+            }
+            return *this;
+        }
+
+        ~Guard() {
+            release();
+        }
+
+        Guard(const Guard&) = delete;
+        Guard& operator=(const Guard&) = delete;
+
+    private:
+        std::atomic<uint64_t>* slot;
+
+        void release() {
+            if (slot) slot->store(idle, std::memory_order_release);
+            slot = nullptr;
+        }
+    };
+
+    EpochReclaimer() : epoch(1) {
+        for (Slot& slot : slots) {
+            slot.epoch.store(idle, std::memory_order_relaxed);
+        }
+    }
+
+    /**
+     * @brief Frees everything still retired; no reader may be pinned any more.
+     */
+    ~EpochReclaimer() {
+        for (Retired& item : retired) {
+            item.free();
+        }
+    }
+
+    EpochReclaimer(const EpochReclaimer&) = delete;
+    EpochReclaimer& operator=(const EpochReclaimer&) = delete;
+
+    /**
+     * @brief Hands over an object that is no longer reachable by new readers.
+     *
+     * @param free Releases the object once no pinned reader can still see it.
+     */
+    void retire(std::function<void()> free) {
+        std::lock_guard<std::mutex> lock(mutex);
+        retired.push_back(Retired{epoch.load(std::memory_order_seq_cst), std::move(free)});
+    }
+
+    /**
+     * @brief Advances the epoch and frees what every pinned reader has moved past.
+     */
+    void collect() {
+        std::lock_guard<std::mutex> lock(mutex);
+        epoch.fetch_add(1, std::memory_order_seq_cst);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        uint64_t oldest = UINT64_MAX;
+        for (const Slot& slot : slots) {
+            uint64_t pinned = slot.epoch.load(std::memory_order_seq_cst);
+            if (pinned != idle && pinned < oldest) oldest = pinned;
+        }
+        size_t kept = 0;
+        for (size_t i = 0; i < retired.size(); ++i) {
+            if (retired[i].epoch < oldest) {
+                retired[i].free();
+            } else {
+                retired[kept++] = std::move(retired[i]);
+            }
+        }
+        retired.resize(kept);
+    }
+
+    /**
+     * @brief Number of retired objects still waiting for readers to move on.
+     */
+    size_t pending() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return retired.size();
+    }
+
+private:
+    static const uint64_t idle = 0;  // Slot value while no reader holds it
+
+    // One reader slot per cache line
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> epoch;
+    };
+
+    struct Retired {
+        uint64_t epoch;
+        std::function<void()> free;
+    };
+
+    std::atomic<uint64_t> epoch;
+    Slot slots[max_readers];
+    mutable std::mutex mutex;  // Writers only: guards the retired list
+    std::vector<Retired> retired;
+
+    static const size_t pin_rounds = 8;  // Full passes over the slots before pin() gives up
+
+    std::atomic<uint64_t>* pin() {
+        size_t start = std::hash<std::thread::id>()(std::this_thread::get_id());
+        for (size_t attempt = 0; attempt < pin_rounds * max_readers; ++attempt) {
+            std::atomic<uint64_t>& slot = slots[(start + attempt) % max_readers].epoch;
+            uint64_t expected = idle;
+            if (slot.load(std::memory_order_relaxed) == idle &&
+                slot.compare_exchange_strong(expected, epoch.load(std::memory_order_seq_cst), std::memory_order_seq_cst)) {
+                // Order the slot store before the reader's next loads (e.g. of a root pointer). With the fence
+                // in collect(), either the reader sees the writer's unlink or the writer sees this pin.
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                return &slot;
+            }
+            if (attempt % max_readers == max_readers - 1) std::this_thread::yield();
+        }
+        throw std::runtime_error("Too many epoch guards are live at once.");
+    }
+};
+
+#endif // EPOCH_RECLAIMER_HPP
@@ -0,0 +1,252 @@
+// minnesav@gmail.com
+
+#ifndef FOREST_HPP
+#define FOREST_HPP
+
+#include <cstdint>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <stdexcept>
+#include "node.hpp"
+
+/**
+ * @brief Many small k-ary trees stored together in one shared arena.
+ *
+ * Nodes of every tree live in two parallel arrays: the values, and 12 bytes of
+ * first-child/next-sibling links per node. Nodes are addressed by a 32-bit handle
+ * (their index in the arena), and a tree is nothing but the handle of its root, so
+ * per-tree overhead is one 4-byte entry in the root list. Whole-forest passes are a
+ * linear scan of the value array, and clear() releases every tree at once.
+ *
+ * @tparam T The type of the values stored in the tree nodes.
+ * @tparam K The maximum number of children each node can have.
+ */
+template <typename T, int K = 2>
+class Forest {
+public:
+    typedef uint32_t Handle;
+    static const Handle none = UINT32_MAX;
+
+    /**
+     * @brief Constructs an empty forest.
+     */
+    Forest() {}
+
+    /**
+     * @brief Reserves room for the given number of nodes and trees.
+     */
+    void reserve(size_t nodes, size_t trees) {
+        values.reserve(nodes);
+        links.reserve(nodes);
+        root_list.reserve(trees);
+    }
+
+    /**
+     * @brief Starts a new tree with a single root node.
+     *
+     * @return Handle The root, which also identifies the tree.
+     */
+    Handle add_tree(const T& value) {
+        Handle root = allocate(value, none);
+        root_list.push_back(root);
+        return root;
+    }
+
+    /**
+     * @brief Appends a child with the given value to a node of any tree in the forest.
+     *
+     * @return Handle The new node.
+     */
+    Handle add_sub_node(Handle parent, const T& value) {
+        if (parent >= links.size()) {
+            throw std::runtime_error("Parent node not found or maximum children exceeded.");
+        }
+        Handle last = none;
+        int count = 0;
+        for (Handle child = links[parent].first_child; child != none; child = links[child].next_sibling) {
+            last = child;
+            ++count;
+        }
+        if (count >= K) {
+            throw std::runtime_error("Parent node not found or maximum children exceeded.");
+        }
+        Handle node = allocate(value, parent);
+        if (last == none) {
+            links[parent].first_child = node;
+        } else {
+            links[last].next_sibling = node;
+        }
+        return node;
+    }
+
+    /**
+     * @brief Copies a pointer-based tree into the forest in BFS order, so its nodes are contiguous.
+     *
+     * @param root The root of the tree to copy (must not be nullptr).
+     * @return Handle The root of the copy.
+     */
+    template <typename Summary>
+    Handle copy_tree(const Node<T, Summary>* root) {
+        if (!root) {
+            throw std::runtime_error("Cannot copy an empty tree into a forest.");
+        }
+        std::vector<const Node<T, Summary>*> order(1, root);
+        Handle first = add_tree(root->value);
+        for (size_t i = 0; i < order.size(); ++i) {
+            Handle parent = first + static_cast<Handle>(i);
+            Handle previous = none;
+            for (const Node<T, Summary>* child : order[i]->children) {
+                if (!child) continue;
+                Handle node = allocate(child->value, parent);
+                if (previous == none) {
+                    links[parent].first_child = node;
+                } else {
+                    links[previous].next_sibling = node;
+                }
+                previous = node;
+                order.push_back(child);
+            }
+        }
+        return first;
+    }
+
+    /**
+     * @brief Builds an independent pointer-based copy of one tree.
+     *
+     * @return Node<T, Summary>* The new root; the caller owns the nodes.
+     */
+    template <typename Summary = StructuralSummary>
+    Node<T, Summary>* materialize(Handle root) const {
+        Node<T, Summary>* result = new Node<T, Summary>(values[root]);
+        std::vector<std::pair<Handle, Node<T, Summary>*>> stack(1, std::make_pair(root, result));
+        while (!stack.empty()) {
+            Handle from = stack.back().first;
+            Node<T, Summary>* to = stack.back().second;
+            stack.pop_back();
+            for (Handle child = links[from].first_child; child != none; child = links[child].next_sibling) {
+                Node<T, Summary>* copy = new Node<T, Summary>(values[child]);
+                to->add_child(copy);
+                stack.push_back(std::make_pair(child, copy));
+            }
+        }
+        return result;
+    }
+
+    /**
+     * @brief Removes every tree at once; the arena keeps its capacity for reuse.
+     */
+    void clear() {
+        values.clear();
+        links.clear();
+        root_list.clear();
+    }
+
+    size_t tree_count() const { return root_list.size(); }
+    size_t size() const { return values.size(); }
+    bool empty() const { return root_list.empty(); }
+
+    // Roots of every tree, in the order they were added
+    const std::vector<Handle>& roots() const { return root_list; }
+
+    T& value(Handle node) { return values[node]; }
+    const T& value(Handle node) const { return values[node]; }
+    Handle parent(Handle node) const { return links[node].parent; }
+    Handle first_child(Handle node) const { return links[node].first_child; }
+    Handle next_sibling(Handle node) const { return links[node].next_sibling; }
+
+    size_t child_count(Handle node) const {
+        size_t count = 0;
+        for (Handle child = links[node].first_child; child != none; child = links[child].next_sibling) {
+            ++count;
+        }
+        return count;
+    }
+
+    /**
+     * @brief Calls f(value) for every node of every tree, in arena order.
+     */
+    template <typename F>
+    void for_each(F f) {
+        for (T& value : values) {
+            f(value);
+        }
+    }
+
+    /**
+     * @brief Calls f(root) for every tree, in the order the trees were added.
+     */
+    template <typename F>
+    void for_each_tree(F f) const {
+        for (Handle root : root_list) {
+            f(root);
+        }
+    }
+
+    /**
+     * @brief Bytes held by the arena and the root list.
+     */
+    size_t memory_bytes() const {
+        return values.capacity() * sizeof(T) + links.capacity() * sizeof(Links) +
+               root_list.capacity() * sizeof(Handle);
+    }
+
+    // Pre-order iterator over one tree
+    class PreOrderIterator {
+    private:
+        const Forest* forest;
+        std::vector<Handle> stack;
+
+    public:
+        PreOrderIterator(const Forest* forest, Handle root) : forest(forest) {
+            if (root != none) stack.push_back(root);
+        }
+
+        bool operator!=(const PreOrderIterator&) const {
+            return !stack.empty();
+        }
+
+        PreOrderIterator& operator++() {
+            Handle node = stack.back();
+            stack.pop_back();
+            size_t first = stack.size();
+            for (Handle child = forest->first_child(node); child != none; child = forest->next_sibling(child)) {
+                stack.push_back(child);
+            }
+            std::reverse(stack.begin() + static_cast<std::ptrdiff_t>(first), stack.end());
+            return *this;
+        }
+
+        Handle operator*() const {
+            return stack.back();
+        }
+    };
+
+    PreOrderIterator begin_pre_order(Handle root) const { return PreOrderIterator(this, root); }
+    PreOrderIterator end_pre_order() const { return PreOrderIterator(this, none); }
+
+private:
+    struct Links {
+        Handle parent;
+        Handle first_child;
+        Handle next_sibling;
+    };
+
+    std::vector<T> values;  // Node values, indexed by handle
+    std::vector<Links> links;  // Node links, indexed by handle
+    std::vector<Handle> root_list;
+
+    Handle allocate(const T& value, Handle parent) {
+        if (values.size() >= none) {
+            throw std::runtime_error("Forest arena is full.");
+        }
+        values.push_back(value);
+        links.push_back(Links{parent, none, none});
+        return static_cast<Handle>(values.size() - 1);
+    }
+};
+
+template <typename T, int K>
+const typename Forest<T, K>::Handle Forest<T, K>::none;
+
+#endif // FOREST_HPP
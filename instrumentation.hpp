@@ -0,0 +1,99 @@
+// minnesav@gmail.com
+
+#ifndef INSTRUMENTATION_HPP
+#define INSTRUMENTATION_HPP
+
+#include <cstddef>
+
+/**
+ * @brief Default instrumentation policy for Tree: every hook is empty, so it compiles away.
+ *
+ * A policy is any class with these five hooks. Tree inherits from it privately
+ * (an empty policy takes no space), and iterators reach it through an
+ * InstrumentationHook, which is also empty for this policy.
+ */
+struct NoInstrumentation {
+    void on_visit() {}
+    void on_frontier(size_t) {}
+    void on_allocate(size_t) {}
+    void on_release(size_t) {}
+    void on_probe() {}
+};
+
+/**
+ * @brief Instrumentation policy that keeps per-tree counters of traversal, allocation and search work.
+ */
+struct CountingInstrumentation {
+    size_t nodes_visited;  // Nodes stepped past by iterators, for_each and visit
+    size_t peak_frontier;  // Largest stack, queue or heap an iterator or visit held
+    size_t allocations;  // Nodes created or taken over by the tree
+    size_t releases;  // Nodes freed by the tree
+    size_t find_probes;  // Nodes compared by find()
+
+    CountingInstrumentation() {
+        reset();
+    }
+
+    void on_visit() { ++nodes_visited; }
+
+    void on_frontier(size_t size) {
+        if (size > peak_frontier) peak_frontier = size;
+    }
+
+    void on_allocate(size_t nodes) { allocations += nodes; }
+    void on_release(size_t nodes) { releases += nodes; }
+    void on_probe() { ++find_probes; }
+
+    void reset() {
+        nodes_visited = 0;
+        peak_frontier = 0;
+        allocations = 0;
+        releases = 0;
+        find_probes = 0;
+    }
+};
+
+/**
+ * @brief What an iterator keeps to report to its tree's policy: a pointer, or nothing when disabled.
+ */
+template <typename Instrumentation>
+class InstrumentationHook {
+public:
+    explicit InstrumentationHook(Instrumentation* target) : target(target) {}
+
+    void on_visit() const {
+        if (target) target->on_visit();
+    }
+
+    void on_frontier(size_t size) const {
+        if (target) target->on_frontier(size);
+    }
+
+private:
+    Instrumentation* target;  // Null for end iterators
+};
+
+template <>
+class InstrumentationHook<NoInstrumentation> {
+public:
+    explicit InstrumentationHook(NoInstrumentation*) {}
+
+    void on_visit() const {}
+    void on_frontier(size_t) const {}
+};
+
+/**
+ * @brief Memory held by a tree's nodes, split into the nodes themselves and their child vectors.
+ */
+struct TreeMemoryUsage {
+    size_t nodes;  // Distinct nodes (shared subtrees count once)
+    size_t node_bytes;  // sizeof(Node<T>) per node
+    size_t child_vector_bytes;  // Capacity of every node's child vector
+    size_t cache_bytes;  // Memoised traversal sequences (see Tree::sequence())
+
+    size_t total_bytes() const {
+        return node_bytes + child_vector_bytes + cache_bytes;
+    }
+};
+
+#endif // INSTRUMENTATION_HPP
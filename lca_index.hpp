@@ -0,0 +1,149 @@
+// minnesav@gmail.com
+
+#ifndef LCA_INDEX_HPP
+#define LCA_INDEX_HPP
+
+#include <vector>
+#include <stack>
+#include <unordered_map>
+#include <stdexcept>
+#include <cstdint>
+#include <utility>
+#include "node.hpp"
+
+/**
+ * @brief Ancestor / lowest-common-ancestor index over a static tree.
+ *
+ * The tree is numbered in pre-order, so every subtree is the contiguous range
+ * [entry, exit] and ancestor checks are two comparisons. For LCA, a sparse table
+ * over the pre-order sequence gives the shallowest node strictly after the first
+ * query node; its parent is the answer.
+ *
+ * @tparam T The type of the values stored in the tree nodes.
+ * @tparam Summary The summary policy of the nodes (see summary.hpp).
+ */
+template <typename T, typename Summary = StructuralSummary>
+class LcaIndex {
+public:
+    /**
+     * @brief Rebuilds the index for the tree rooted at the given node.
+     *
+     * Runs in O(n log n) time and memory (the sparse table); everything else is O(n).
+     *
+     * @param root The root of the tree to index (may be nullptr).
+     */
+    void build(Node<T, Summary>* root) {
+        order.clear();
+        nodes.clear();
+        parents.clear();
+        depths.clear();
+        exits.clear();
+        table.clear();
+        logs.clear();
+        if (!root) return;
+
+        // Iterative pre-order numbering: (node, parent number, depth)
+        struct Frame { Node<T, Summary>* node; size_t parent; size_t depth; };
+        std::stack<Frame> stack;
+        stack.push(Frame{root, 0, 0});
+        while (!stack.empty()) {
+            Frame frame = stack.top();
+            stack.pop();
+            size_t number = nodes.size();
+            order[frame.node] = number;
+            nodes.push_back(frame.node);
+            parents.push_back(frame.parent);
+            depths.push_back(frame.depth);
+            for (auto it = frame.node->children.rbegin(); it != frame.node->children.rend(); ++it) {
+                stack.push(Frame{*it, number, frame.depth + 1});
+            }
+        }
+
+        // A subtree ends where the next node at the same or a shallower depth begins
+        size_t n = nodes.size();
+        exits.assign(n, n - 1);
+        std::vector<size_t> open;
+        for (size_t i = 0; i < n; ++i) {
+            while (!open.empty() && depths[open.back()] >= depths[i]) {
+                exits[open.back()] = i - 1;
+                open.pop_back();
+            }
+            open.push_back(i);
+        }
+
+        // Sparse table of the shallowest pre-order number in every power-of-two window
+        logs.assign(n + 1, 0);
+        for (size_t i = 2; i <= n; ++i) {
+            logs[i] = static_cast<uint8_t>(logs[i / 2] + 1);
+        }
+        table.push_back(std::vector<uint32_t>(n));
+        for (size_t i = 0; i < n; ++i) {
+            table[0][i] = static_cast<uint32_t>(i);
+        }
+        for (size_t level = 1; (size_t(1) << level) <= n; ++level) {
+            size_t half = size_t(1) << (level - 1);
+            const std::vector<uint32_t>& prev = table[level - 1];
+            std::vector<uint32_t> row(n - (size_t(1) << level) + 1);
+            for (size_t i = 0; i < row.size(); ++i) {
+                row[i] = shallower(prev[i], prev[i + half]);
+            }
+            table.push_back(row);
+        }
+    }
+
+    /**
+     * @brief Checks whether one node is an ancestor of (or the same as) another, in O(1).
+     */
+    bool is_ancestor(const Node<T, Summary>* ancestor, const Node<T, Summary>* node) const {
+        size_t a = number(ancestor);
+        size_t b = number(node);
+        return a <= b && b <= exits[a];
+    }
+
+    /**
+     * @brief Returns the lowest common ancestor of two nodes, in O(1).
+     */
+    Node<T, Summary>* lca(const Node<T, Summary>* first, const Node<T, Summary>* second) const {
+        size_t a = number(first);
+        size_t b = number(second);
+        if (a > b) std::swap(a, b);
+        if (b <= exits[a]) return nodes[a];  // One contains the other
+        return nodes[parents[minimum(a + 1, b)]];
+    }
+
+    /**
+     * @brief Returns the depth of a node (the root has depth 0), in O(1).
+     */
+    size_t depth(const Node<T, Summary>* node) const {
+        return depths[number(node)];
+    }
+
+private:
+    std::unordered_map<const Node<T, Summary>*, size_t> order;  // Node -> pre-order number
+    std::vector<Node<T, Summary>*> nodes;  // Pre-order number -> node
+    std::vector<size_t> parents;  // Pre-order number of each node's parent
+    std::vector<size_t> depths;
+    std::vector<size_t> exits;  // Last pre-order number inside each subtree
+    std::vector<std::vector<uint32_t>> table;
+    std::vector<uint8_t> logs;  // floor(log2(length)) for window lengths up to n
+
+    size_t number(const Node<T, Summary>* node) const {
+        auto it = order.find(node);
+        if (it == order.end()) {
+            throw std::runtime_error("Node is not part of the indexed tree.");
+        }
+        return it->second;
+    }
+
+    uint32_t shallower(uint32_t a, uint32_t b) const {
+        return depths[b] < depths[a] ? b : a;
+    }
+
+    // Shallowest pre-order number in [from, to]
+    size_t minimum(size_t from, size_t to) const {
+        size_t level = logs[to - from + 1];
+        return shallower(table[level][from], table[level][to + 1 - (size_t(1) << level)]);
+    }
+};
+
+#endif // LCA_INDEX_HPP
@@ -61,6 +61,7 @@ void traverse_demo() {
 
         TreePrinter<double, 2> printer;
         printer.print(tree, "binary_tree.dot", "binary_tree.png");  // Unique filenames
+        printer.print_svg(tree, "binary_tree.svg");  // Built-in layout, no Graphviz needed
     }
 
     {
@@ -165,6 +166,7 @@ int main() {
     TreePrinter<Complex, 4> complex_printer;
     complex_printer.print(complex_tree, "complex_tree.dot", "complex_tree.png");  // Unique filenames
 
+    complex_printer.flush();  // Wait for the background PNG renders of every printer
     return 0;
 }
 
@@ -5,19 +5,59 @@
 
 #include <vector>
 #include <iostream>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include "summary.hpp"
 
-template <typename T>
-class Node {
+/**
+ * @brief Finalises a 64-bit hash so that every input bit affects every output bit (splitmix64).
+ */
+inline uint64_t hash_mix(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+/**
+ * @brief Mixes a value into a running hash; the result depends on the order of the values mixed in.
+ *
+ * Both inputs go through hash_mix(), so structurally different subtrees collide only
+ * by chance (about 2^-64 per comparison) as long as std::hash<T> separates their values.
+ *
+ * @param seed The hash accumulated so far.
+ * @param value The hash to mix in.
+ * @return size_t The combined hash.
+ */
+inline size_t hash_combine(size_t seed, size_t value) {
+    return static_cast<size_t>(hash_mix(seed + 0x9e3779b97f4a7c15ULL + hash_mix(value)));
+}
+
+/**
+ * @brief A tree node; its Summary policy (see summary.hpp) adds the per-subtree fields Tree maintains.
+ *
+ * The parent link and sibling index are always present: Tree walks them to refresh
+ * summaries after every mutation, and the stackless iterators, path_to_root() and
+ * detach()/attach()/erase() follow them. They take 12 bytes per node on a 64-bit
+ * target. The index sits next to the value, so for a 4-byte T it fills what would be
+ * padding: Node<int> is 64 bytes, against 32 without the summary and the links.
+ */
+template <typename T, typename Summary = StructuralSummary>
+class Node : public Summary {
 public:
     T value;
-    std::vector<Node<T>*> children;
+    uint32_t sibling_index;  // Position of this node in parent->children (K is an int, so it fits)
+    std::vector<Node<T, Summary>*> children;
+    Node<T, Summary>* parent;  // Parent node, or nullptr for a root
 
     /**
      * @brief Constructs a new Node object with the given value.
      *
      * @param val The value to be stored in the node.
      */
-    Node(T val) : value(val) {}
+    Node(T val) : Summary(val), value(val), sibling_index(0), parent(nullptr) {}
 
     /**
      * @brief Returns a reference to the value.
@@ -44,15 +84,46 @@ public:
     /**
      * @brief Adds a child to the node.
      * 
-     * This function adds a child node to the current node. The child node is added to the end of the list of children.
+     * This function adds a child node to the current node. The child node is added to the end of the list of children,
+     * and its parent link and sibling index are set accordingly.
      * 
      * @param child A pointer to the child node to be added.
      */
-    void add_child(Node<T>* child) { // Add a child to the node
+    void add_child(Node<T, Summary>* child) { // Add a child to the node
+        child->parent = this;
+        child->sibling_index = static_cast<uint32_t>(children.size());
         children.push_back(child);
     }
 };
 
+/**
+ * @brief Checks that two subtrees have the same shape and equal values, without recursion.
+ *
+ * Tree::operator== and diff() trust the Merkle hashes instead; Tree::deep_equal() uses
+ * this walk when a hash collision must be ruled out.
+ *
+ * @param a The root of the first subtree (may be nullptr).
+ * @param b The root of the second subtree (may be nullptr).
+ * @return bool True if both subtrees are structurally identical.
+ */
+template <typename T, typename Summary>
+bool same_subtree(const Node<T, Summary>* a, const Node<T, Summary>* b) {
+    std::vector<std::pair<const Node<T, Summary>*, const Node<T, Summary>*>> stack(1, std::make_pair(a, b));
+    while (!stack.empty()) {
+        const Node<T, Summary>* left = stack.back().first;
+        const Node<T, Summary>* right = stack.back().second;
+        stack.pop_back();
+        if (left == right) continue;  // Same node (or both null), e.g. shared by compress()
+        if (!left || !right || !(left->value == right->value) || left->children.size() != right->children.size()) {
+            return false;
+        }
+        for (size_t i = 0; i < left->children.size(); ++i) {
+            stack.push_back(std::make_pair(left->children[i], right->children[i]));
+        }
+    }
+    return true;
+}
+
 #endif // NODE_HPP
 
 
@@ -0,0 +1,625 @@
+// minnesav@gmail.com
+
+#ifndef PAGED_TREE_HPP
+#define PAGED_TREE_HPP
+
+#include <cstdint>
+#include <climits>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <list>
+#include <iterator>
+#include <algorithm>
+#include <unordered_map>
+#include <fstream>
+#include <stdexcept>
+#include <type_traits>
+#include <fcntl.h>
+#include <unistd.h>
+#include "node.hpp"
+#include "tree_io.hpp"
+
+/*
+ * Paged tree file layout (host byte order):
+ *
+ *   PagedFileHeader, padded to 8 bytes
+ *   page[0], page[1], ...   each nodes_per_page PagedRecord<T> slots, the last page zero-padded
+ *
+ * Nodes are numbered in BFS order, so the children of a node are consecutive records
+ * and a BFS scan reads the pages strictly front to back.
+ */
+
+/**
+ * @brief Fixed-size header at the start of every paged tree file.
+ */
+struct PagedFileHeader {
+    char magic[4];  // "KPAG"
+    uint32_t version;
+    uint32_t byte_order;  // 0x01020304 as written by the producing host
+    uint32_t value_size;  // sizeof(T)
+    uint32_t value_kind;  // TREE_VALUE_* kind of T (see tree_io.hpp)
+    uint32_t reserved;  // Zero
+    uint64_t node_count;
+    uint64_t max_children;  // Largest child count in the file
+    uint64_t nodes_per_page;
+};
+
+static const uint32_t PAGED_FILE_VERSION = 2;
+
+/**
+ * @brief On-disk form of one node: its value and its links by BFS index.
+ *
+ * @tparam T The type of the values stored in the tree nodes.
+ */
+template <typename T>
+struct PagedRecord {
+    T value;
+    uint64_t parent;  // UINT64_MAX for the root
+    uint64_t first_child;  // Index of the first child; the others follow it
+    uint64_t child_count;
+};
+
+/**
+ * @brief Streams nodes into a paged tree file in BFS order, holding one page in memory.
+ *
+ * This is how trees larger than memory are built: the caller adds the root, then
+ * the children of node 0, then those of node 1, and so on (each node's children in
+ * order). Nodes are numbered in the order they are added. Full pages are written as
+ * they fill up; a parent's child links are patched in place once its children are
+ * known. The file is only valid after finish(), which writes the header.
+ *
+ * @tparam T The type of the values stored in the tree nodes.
+ * @tparam K The maximum number of children each node can have.
+ */
+template <typename T, int K = 2>
+class PagedTreeWriter {
+    static_assert(std::is_trivially_copyable<T>::value, "Paged tree files need trivially copyable values.");
+    typedef PagedRecord<T> Record;
+
+public:
+    /**
+     * @brief Creates (or truncates) the file.
+     *
+     * @param path The file to write.
+     * @param nodes_per_page The number of node records per page.
+     */
+    explicit PagedTreeWriter(const std::string& path, size_t nodes_per_page = 1024)
+        : fd(-1), nodes_per_page(nodes_per_page), count(0), page_start(0), max_children(0),
+          parent(0), first_child(0), child_count(0), finished(false) {
+        if (nodes_per_page == 0) {
+            throw std::runtime_error("Paged tree files need at least one node per page.");
+        }
+        fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            throw std::runtime_error("Could not open file to write paged tree.");
+        }
+        page.reserve(nodes_per_page);
+    }
+
+    ~PagedTreeWriter() {
+        ::close(fd);
+    }
+
+    PagedTreeWriter(const PagedTreeWriter&) = delete;
+    PagedTreeWriter& operator=(const PagedTreeWriter&) = delete;
+
+    /**
+     * @brief Adds the root; it must be the first node.
+     *
+     * @return size_t The root's index (0).
+     */
+    size_t add_root(const T& value) {
+        if (count != 0 || finished) {
+            throw std::runtime_error("Paged tree already has a root.");
+        }
+        return append(value, UINT64_MAX);
+    }
+
+    /**
+     * @brief Adds the next child of the given node.
+     *
+     * @param parent_index A node added earlier, no smaller than the parent of the previous child (BFS order).
+     * @return size_t The new node's index.
+     */
+    size_t add_child(size_t parent_index, const T& value) {
+        if (finished || parent_index >= count || parent_index < parent) {
+            throw std::runtime_error("Paged tree nodes must be added in BFS order.");
+        }
+        if (parent_index != parent || child_count == 0) {
+            linkChildren();
+            parent = parent_index;
+            first_child = count;
+            child_count = 0;
+        }
+        if (child_count >= static_cast<uint64_t>(K)) {
+            throw std::runtime_error("Parent node not found or maximum children exceeded.");
+        }
+        ++child_count;
+        return append(value, parent_index);
+    }
+
+    /**
+     * @brief Number of nodes added so far.
+     */
+    size_t size() const {
+        return count;
+    }
+
+    /**
+     * @brief Writes the last page and the header; no nodes can be added afterwards.
+     */
+    void finish() {
+        if (finished) return;
+        linkChildren();
+        if (!page.empty()) {
+            Record empty;
+            std::memset(&empty, 0, sizeof(empty));
+            page.resize(nodes_per_page, empty);
+            writePage();
+        }
+        PagedFileHeader header;
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, "KPAG", 4);
+        header.version = PAGED_FILE_VERSION;
+        header.byte_order = TREE_FILE_BYTE_ORDER;
+        header.value_size = sizeof(T);
+        header.value_kind = TreeValueKindOf<T>::value;
+        header.node_count = count;
+        header.max_children = max_children;
+        header.nodes_per_page = nodes_per_page;
+        write(&header, sizeof(header), 0);
+        finished = true;
+    }
+
+private:
+    int fd;
+    size_t nodes_per_page;
+    size_t count;  // Nodes added so far
+    size_t page_start;  // Index of the first node in `page`
+    std::vector<Record> page;  // Records not yet written
+    uint64_t max_children;
+    size_t parent;  // Node whose children are being added
+    uint64_t first_child;
+    uint64_t child_count;
+    bool finished;
+
+    static size_t dataOffset() {
+        return (sizeof(PagedFileHeader) + 7) / 8 * 8;
+    }
+
+    size_t append(const T& value, uint64_t parent_index) {
+        Record record;
+        std::memset(&record, 0, sizeof(record));
+        record.value = value;
+        record.parent = parent_index;
+        page.push_back(record);
+        if (page.size() == nodes_per_page) writePage();
+        return count++;
+    }
+
+    // Record the current parent's child range, in the buffered page or in place in the file
+    void linkChildren() {
+        if (child_count == 0) return;
+        max_children = std::max(max_children, child_count);
+        if (parent >= page_start) {
+            page[parent - page_start].first_child = first_child;
+            page[parent - page_start].child_count = child_count;
+        } else {
+            Record record;
+            size_t links = static_cast<size_t>(reinterpret_cast<char*>(&record.first_child) - reinterpret_cast<char*>(&record));
+            uint64_t range[2] = {first_child, child_count};  // first_child and child_count are adjacent
+            write(range, sizeof(range), dataOffset() + parent * sizeof(Record) + links);
+        }
+        child_count = 0;
+    }
+
+    void writePage() {
+        write(page.data(), page.size() * sizeof(Record), dataOffset() + page_start * sizeof(Record));
+        page_start += page.size();
+        page.clear();
+    }
+
+    void write(const void* data, size_t length, size_t offset) {
+        const char* bytes = static_cast<const char*>(data);
+        while (length) {
+            ssize_t done = ::pwrite(fd, bytes, length, static_cast<off_t>(offset));
+            if (done <= 0) {
+                throw std::runtime_error("Could not write paged tree.");
+            }
+            bytes += done;
+            offset += static_cast<size_t>(done);
+            length -= static_cast<size_t>(done);
+        }
+    }
+};
+
+/**
+ * @brief Writes the tree rooted at the given node to a paged tree file.
+ *
+ * @param root The root of the tree (may be nullptr for an empty file).
+ * @param path The file to create or overwrite.
+ * @param nodes_per_page The number of node records per page.
+ */
+template <typename T, typename Summary>
+void save_paged_tree(const Node<T, Summary>* root, const std::string& path, size_t nodes_per_page = 1024) {
+    PagedTreeWriter<T, INT_MAX> writer(path, nodes_per_page);
+    // BFS numbering: a node's children are appended to the order together
+    std::vector<const Node<T, Summary>*> order;
+    if (root) {
+        order.push_back(root);
+        writer.add_root(root->value);
+    }
+    for (size_t i = 0; i < order.size(); ++i) {
+        for (const Node<T, Summary>* child : order[i]->children) {
+            if (!child) continue;
+            order.push_back(child);
+            writer.add_child(i, child->value);
+        }
+    }
+    writer.finish();
+}
+
+/**
+ * @brief A read-only tree that stays on disk and pages its nodes in on demand.
+ *
+ * Nodes are addressed by their BFS index (the root is 0). Whole pages of nodes are
+ * read from the file into an LRU cache bounded by a memory budget, so only the pages
+ * a traversal touches are ever resident. The traversals hint the kernel to read ahead
+ * the page they will need next.
+ *
+ * The iterators and root() yield a NodeRef, which behaves like a const Node<T>*:
+ * node->value, node->get_value() and node->children work on both, so traversal and
+ * visitor code templated on the node pointer type runs on a Tree and on a PagedTree.
+ * There are no parent pointers or summaries; parent(i) and the index accessors cover that.
+ *
+ * @tparam T The type of the values stored in the tree nodes.
+ * @tparam K The maximum number of children each node can have.
+ */
+template <typename T, int K = 2>
+class PagedTree {
+    typedef PagedRecord<T> Record;
+
+public:
+    static const size_t none = size_t(-1);
+
+    /**
+     * @brief Opens a paged tree file.
+     *
+     * @param path The file written by PagedTreeWriter, save_paged_tree() or Tree::save_paged().
+     * @param memory_budget The most bytes of pages to keep cached (at least one page is kept).
+     */
+    explicit PagedTree(const std::string& path, size_t memory_budget = size_t(64) << 20)
+        : fd(-1), hits(0), misses(0) {
+        fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("Could not open " + path + ".");
+        }
+        try {
+            readHeader();
+        } catch (...) {
+            ::close(fd);
+            throw;
+        }
+        max_pages = std::max<size_t>(1, memory_budget / page_bytes);
+    }
+
+    ~PagedTree() {
+        ::close(fd);
+    }
+
+    PagedTree(const PagedTree&) = delete;
+    PagedTree& operator=(const PagedTree&) = delete;
+
+    /**
+     * @brief Number of nodes in the tree.
+     */
+    size_t size() const {
+        return node_count;
+    }
+
+    /**
+     * @brief Value of node i (copied out, as its page may be evicted later).
+     */
+    T value(size_t i) {
+        return record(i).value;
+    }
+
+    /**
+     * @brief Number of children of node i.
+     */
+    size_t child_count(size_t i) {
+        return static_cast<size_t>(record(i).child_count);
+    }
+
+    /**
+     * @brief Index of the k-th child of node i.
+     */
+    size_t child(size_t i, size_t k) {
+        const Record& node = record(i);
+        if (k >= node.child_count) {
+            throw std::out_of_range("Paged tree node has no such child.");
+        }
+        return static_cast<size_t>(node.first_child + k);
+    }
+
+    /**
+     * @brief Index of the parent of node i, or PagedTree::none for the root.
+     */
+    size_t parent(size_t i) {
+        uint64_t up = record(i).parent;
+        return up == UINT64_MAX ? none : static_cast<size_t>(up);
+    }
+
+    /**
+     * @brief Asks the kernel to start reading the page of node i if it is not cached.
+     */
+    void prefetch(size_t i) {
+        if (i >= node_count) return;
+        size_t page = i / nodes_per_page;
+        if (index.count(page)) return;
+        ::posix_fadvise(fd, static_cast<off_t>(pageOffset(page)), static_cast<off_t>(page_bytes), POSIX_FADV_WILLNEED);
+    }
+
+    /**
+     * @brief Changes the memory budget, evicting least recently used pages as needed.
+     */
+    void set_memory_budget(size_t bytes) {
+        max_pages = std::max<size_t>(1, bytes / page_bytes);
+        while (pages.size() > max_pages) evict();
+    }
+
+    class NodeRef;
+
+    // The children of a paged node: consecutive BFS indices, read as NodeRefs on access
+    class ChildRange {
+    public:
+        class ChildIterator {
+        public:
+            ChildIterator(PagedTree* tree, size_t current) : tree(tree), current(current) {}
+
+            bool operator!=(const ChildIterator& other) const { return current != other.current; }
+            bool operator==(const ChildIterator& other) const { return current == other.current; }
+
+            ChildIterator& operator++() {
+                ++current;
+                return *this;
+            }
+
+            NodeRef operator*() const { return NodeRef(tree, current); }
+
+        private:
+            PagedTree* tree;
+            size_t current;
+        };
+
+        ChildRange(PagedTree* tree, size_t first, size_t count) : tree(tree), first(first), count(count) {}
+
+        ChildIterator begin() const { return ChildIterator(tree, first); }
+        ChildIterator end() const { return ChildIterator(tree, first + count); }
+        size_t size() const { return count; }
+        bool empty() const { return count == 0; }
+
+        NodeRef operator[](size_t k) const { return NodeRef(tree, first + k); }
+
+    private:
+        PagedTree* tree;
+        size_t first;
+        size_t count;
+    };
+
+    // Pointer-like view of one node; it holds a copy of the value and the child links, never a pointer into a page,
+    // so evictions cannot invalidate it
+    class NodeRef {
+    public:
+        T value;
+        ChildRange children;
+
+        NodeRef(PagedTree* tree, size_t i) : NodeRef(tree, i, tree->record(i)) {}
+
+        const NodeRef* operator->() const { return this; }
+        const T& get_value() const { return value; }
+        size_t index() const { return node_index; }
+
+    private:
+        size_t node_index;
+
+        NodeRef(PagedTree* tree, size_t i, const Record& record)
+            : value(record.value),
+              children(tree, static_cast<size_t>(record.first_child), static_cast<size_t>(record.child_count)),
+              node_index(i) {}
+    };
+
+    /**
+     * @brief The root as a NodeRef (the tree must not be empty).
+     */
+    NodeRef root() {
+        return NodeRef(this, 0);
+    }
+
+    size_t page_size() const { return page_bytes; }
+    size_t page_count() const { return (node_count + nodes_per_page - 1) / nodes_per_page; }
+    size_t resident_pages() const { return pages.size(); }
+    size_t cache_hits() const { return hits; }
+    size_t cache_misses() const { return misses; }
+
+    // BFS Iterator: BFS indices are the file order, so this is a sequential page scan
+    class BFSIterator {
+    private:
+        PagedTree* tree;
+        size_t current;
+
+    public:
+        BFSIterator(PagedTree* tree, size_t start) : tree(tree), current(start) {
+            if (tree && current < tree->size()) tree->prefetch(current + tree->nodes_per_page);
+        }
+
+        bool operator!=(const BFSIterator& other) const {
+            return current != other.current;
+        }
+
+        BFSIterator& operator++() {
+            ++current;
+            if (current % tree->nodes_per_page == 0) {
+                tree->prefetch(current + tree->nodes_per_page);
+            }
+            return *this;
+        }
+
+        NodeRef operator*() const {
+            return NodeRef(tree, current);
+        }
+
+        size_t index() const {
+            return current;
+        }
+    };
+
+    // DFS Iterator (pre-order): keeps node indices on its stack, never whole nodes
+    class DFSIterator {
+    private:
+        PagedTree* tree;
+        std::vector<size_t> stack;
+
+    public:
+        DFSIterator(PagedTree* tree, bool at_begin) : tree(tree) {
+            if (at_begin && tree->size()) stack.push_back(0);
+        }
+
+        bool operator!=(const DFSIterator& other) const {
+            return stack.size() != other.stack.size() || (!stack.empty() && stack.back() != other.stack.back());
+        }
+
+        DFSIterator& operator++() {
+            size_t node = stack.back();
+            stack.pop_back();
+            const Record& record = tree->record(node);
+            size_t first = static_cast<size_t>(record.first_child);
+            for (size_t c = static_cast<size_t>(record.child_count); c-- > 0;) {
+                stack.push_back(first + c);
+            }
+            // The next node is paged in right away; the one after its subtree can load meanwhile
+            if (stack.size() > 1) tree->prefetch(stack[stack.size() - 2]);
+            return *this;
+        }
+
+        NodeRef operator*() const {
+            return NodeRef(tree, stack.back());
+        }
+
+        size_t index() const {
+            return stack.back();
+        }
+    };
+
+    typedef DFSIterator PreOrderIterator;
+
+    BFSIterator begin_bfs_scan() { return BFSIterator(this, 0); }
+    BFSIterator end_bfs_scan() { return BFSIterator(this, node_count); }
+
+    DFSIterator begin_dfs_scan() { return DFSIterator(this, true); }
+    DFSIterator end_dfs_scan() { return DFSIterator(this, false); }
+
+    PreOrderIterator begin_pre_order() { return begin_dfs_scan(); }
+    PreOrderIterator end_pre_order() { return end_dfs_scan(); }
+
+private:
+    // A cached page: its number and its raw records
+    struct Page {
+        size_t number;
+        std::vector<char> bytes;
+    };
+
+    int fd;
+    size_t node_count;
+    size_t nodes_per_page;
+    size_t page_bytes;
+    size_t data_offset;  // File offset of page 0
+    size_t max_pages;
+    std::list<Page> pages;  // Most recently used first
+    std::unordered_map<size_t, typename std::list<Page>::iterator> index;  // Page number -> cache entry
+    size_t hits;
+    size_t misses;
+
+    size_t pageOffset(size_t page) const {
+        return data_offset + page * page_bytes;
+    }
+
+    void readHeader() {
+        PagedFileHeader header;
+        if (::pread(fd, &header, sizeof(header), 0) != static_cast<ssize_t>(sizeof(header))) {
+            throw std::runtime_error("Paged tree file is truncated.");
+        }
+        if (std::memcmp(header.magic, "KPAG", 4) != 0) {
+            throw std::runtime_error("Not a paged tree file.");
+        }
+        if (header.version != PAGED_FILE_VERSION) {
+            throw std::runtime_error("Unsupported paged tree file version.");
+        }
+        if (header.byte_order != TREE_FILE_BYTE_ORDER) {
+            throw std::runtime_error("Paged tree file was written with a different byte order.");
+        }
+        if (header.value_size != sizeof(T) || header.value_kind != TreeValueKindOf<T>::value) {
+            throw std::runtime_error("Paged tree file holds a different value type.");
+        }
+        if (header.max_children > static_cast<uint64_t>(K)) {
+            throw std::runtime_error("Paged tree file exceeds the maximum number of children.");
+        }
+        if (header.nodes_per_page == 0) {
+            throw std::runtime_error("Paged tree file structure is corrupt.");
+        }
+        node_count = static_cast<size_t>(header.node_count);
+        nodes_per_page = static_cast<size_t>(header.nodes_per_page);
+        page_bytes = nodes_per_page * sizeof(Record);
+        data_offset = (sizeof(header) + 7) / 8 * 8;
+    }
+
+    // Record of node i, valid until the next page is loaded
+    const Record& record(size_t i) {
+        if (i >= node_count) {
+            throw std::out_of_range("Paged tree node index out of range.");
+        }
+        const Page& page = load(i / nodes_per_page);
+        return reinterpret_cast<const Record*>(page.bytes.data())[i % nodes_per_page];
+    }
+
+    const Page& load(size_t number) {
+        auto found = index.find(number);
+        if (found != index.end()) {
+            ++hits;
+            pages.splice(pages.begin(), pages, found->second);
+            return pages.front();
+        }
+        ++misses;
+        if (pages.size() >= max_pages) {
+            pages.splice(pages.begin(), pages, std::prev(pages.end()));  // Reuse the oldest buffer
+            index.erase(pages.front().number);
+        } else {
+            pages.push_front(Page{number, std::vector<char>(page_bytes)});
+        }
+        Page& page = pages.front();
+        page.number = number;
+        index[number] = pages.begin();
+        size_t done = 0;
+        while (done < page_bytes) {
+            ssize_t got = ::pread(fd, &page.bytes[done], page_bytes - done, static_cast<off_t>(pageOffset(number) + done));
+            if (got <= 0) {
+                index.erase(number);
+                pages.pop_front();
+                throw std::runtime_error("Paged tree file is truncated.");
+            }
+            done += static_cast<size_t>(got);
+        }
+        return page;
+    }
+
+    void evict() {
+        index.erase(pages.back().number);
+        pages.pop_back();
+    }
+};
+
+template <typename T, int K>
+const size_t PagedTree<T, K>::none;
+
+#endif // PAGED_TREE_HPP
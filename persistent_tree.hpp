@@ -0,0 +1,308 @@
+// minnesav@gmail.com
+
+#ifndef PERSISTENT_TREE_HPP
+#define PERSISTENT_TREE_HPP
+
+#include <memory>
+#include <vector>
+#include <queue>
+#include <stdexcept>
+#include "node.hpp"
+
+/**
+ * @brief An immutable node of a PersistentTree, shared between every version that contains it.
+ *
+ * @tparam T The type of the value stored in the node.
+ */
+template <typename T>
+struct PersistentNode {
+    T value;
+    std::vector<std::shared_ptr<const PersistentNode>> children;
+    size_t size;  // Number of nodes in the subtree rooted here
+
+    explicit PersistentNode(const T& val) : value(val), size(1) {}
+
+    PersistentNode(const PersistentNode&) = default;
+
+    // Frees the chain of nodes only this node still references from an explicit stack, so
+    // dropping the last version of a deep tree does not recurse once per level
+    ~PersistentNode() {
+        std::vector<std::shared_ptr<const PersistentNode>> stack;
+        stack.swap(children);
+        while (!stack.empty()) {
+            std::shared_ptr<const PersistentNode> node = std::move(stack.back());
+            stack.pop_back();
+            if (node.use_count() == 1) {
+                // Last owner: take its children before it goes. Every node is created non-const (see
+                // PersistentTree), so writing through the const pointer is well defined.
+                std::vector<std::shared_ptr<const PersistentNode>>& orphans = const_cast<PersistentNode*>(node.get())->children;
+                for (std::shared_ptr<const PersistentNode>& orphan : orphans) {
+                    stack.push_back(std::move(orphan));
+                }
+                orphans.clear();
+            }
+        }
+    }
+};
+
+/**
+ * @brief A k-ary tree whose versions share structure: a snapshot is O(1) and an update O(depth).
+ *
+ * Nodes are never modified once built. An update copies only the nodes on the path
+ * from the root to the change and links them to the untouched subtrees of the old
+ * version, so every earlier snapshot stays valid. Nodes are reference counted and
+ * freed when the last version that uses them goes away.
+ *
+ * Nodes are addressed by their path from the root: the child index to take at each level.
+ *
+ * @tparam T The type of the values stored in the tree nodes.
+ * @tparam K The maximum number of children each node can have.
+ */
+template <typename T, int K = 2>
+class PersistentTree {
+public:
+    typedef std::shared_ptr<const PersistentNode<T>> NodeRef;
+    typedef std::vector<size_t> Path;
+
+    /**
+     * @brief Constructs an empty tree.
+     */
+    PersistentTree() {}
+
+    /**
+     * @brief Copies a pointer-based tree once; later versions share its nodes.
+     *
+     * @param root The root of the tree to copy (may be nullptr).
+     */
+    template <typename Summary>
+    explicit PersistentTree(const Node<T, Summary>* root) : top(copy(root)) {}
+
+    /**
+     * @brief Returns the current version. Later updates to either tree do not affect the other.
+     */
+    PersistentTree snapshot() const {
+        return *this;
+    }
+
+    /**
+     * @brief Root of the current version (null when empty).
+     */
+    const NodeRef& root() const {
+        return top;
+    }
+
+    /**
+     * @brief Number of nodes in the current version.
+     */
+    size_t size() const {
+        return top ? top->size : 0;
+    }
+
+    /**
+     * @brief Node at the given path, or nullptr if the path leaves the tree.
+     */
+    const PersistentNode<T>* find(const Path& path) const {
+        const PersistentNode<T>* node = top.get();
+        for (size_t i = 0; node && i < path.size(); ++i) {
+            node = path[i] < node->children.size() ? node->children[path[i]].get() : nullptr;
+        }
+        return node;
+    }
+
+    /**
+     * @brief Creates the root, or replaces the root's value if there is one.
+     */
+    void add_root(const T& value) {
+        if (!top) {
+            top = std::make_shared<PersistentNode<T>>(value);
+        } else {
+            set_value(Path(), value);
+        }
+    }
+
+    /**
+     * @brief Appends a child with the given value to the node at the given path.
+     */
+    void add_sub_node(const Path& parent, const T& value) {
+        update(parent, [&value](const PersistentNode<T>& node) -> NodeRef {
+            if (node.children.size() >= K) {
+                throw std::runtime_error("Parent node not found or maximum children exceeded.");
+            }
+            std::shared_ptr<PersistentNode<T>> changed = std::make_shared<PersistentNode<T>>(node);
+            changed->children.push_back(std::make_shared<PersistentNode<T>>(value));
+            changed->size += 1;
+            return changed;
+        });
+    }
+
+    /**
+     * @brief Replaces the value of the node at the given path.
+     */
+    void set_value(const Path& path, const T& value) {
+        update(path, [&value](const PersistentNode<T>& node) -> NodeRef {
+            std::shared_ptr<PersistentNode<T>> changed = std::make_shared<PersistentNode<T>>(node);
+            changed->value = value;
+            return changed;
+        });
+    }
+
+    /**
+     * @brief Removes the subtree at the given path (the whole tree for an empty path).
+     */
+    void remove(const Path& path) {
+        update(path, [](const PersistentNode<T>&) -> NodeRef { return NodeRef(); });
+    }
+
+    /**
+     * @brief Builds an independent pointer-based copy of the current version.
+     *
+     * @return Node<T, Summary>* The new root (nullptr when empty); the caller owns the nodes.
+     */
+    template <typename Summary = StructuralSummary>
+    Node<T, Summary>* materialize() const {
+        if (!top) return nullptr;
+        Node<T, Summary>* result = new Node<T, Summary>(top->value);
+        std::vector<std::pair<const PersistentNode<T>*, Node<T, Summary>*>> stack;
+        stack.push_back(std::make_pair(top.get(), result));
+        while (!stack.empty()) {
+            const PersistentNode<T>* from = stack.back().first;
+            Node<T, Summary>* to = stack.back().second;
+            stack.pop_back();
+            for (const NodeRef& child : from->children) {
+                Node<T, Summary>* copy = new Node<T, Summary>(child->value);
+                to->add_child(copy);
+                stack.push_back(std::make_pair(child.get(), copy));
+            }
+        }
+        return result;
+    }
+
+    // DFS Iterator (pre-order)
+    class DFSIterator {
+    private:
+        std::vector<const PersistentNode<T>*> stack;
+
+    public:
+        DFSIterator(const PersistentNode<T>* root) {
+            if (root) stack.push_back(root);
+        }
+
+        bool operator!=(const DFSIterator&) const {
+            return !stack.empty();
+        }
+
+        DFSIterator& operator++() {
+            const PersistentNode<T>* node = stack.back();
+            stack.pop_back();
+            for (auto it = node->children.rbegin(); it != node->children.rend(); ++it) {
+                stack.push_back(it->get());
+            }
+            return *this;
+        }
+
+        const PersistentNode<T>* operator*() const {
+            return stack.back();
+        }
+
+        const PersistentNode<T>* operator->() const {
+            return stack.back();
+        }
+    };
+
+    // BFS Iterator
+    class BFSIterator {
+    private:
+        std::queue<const PersistentNode<T>*> queue;
+
+    public:
+        BFSIterator(const PersistentNode<T>* root) {
+            if (root) queue.push(root);
+        }
+
+        bool operator!=(const BFSIterator&) const {
+            return !queue.empty();
+        }
+
+        BFSIterator& operator++() {
+            const PersistentNode<T>* node = queue.front();
+            queue.pop();
+            for (const NodeRef& child : node->children) {
+                queue.push(child.get());
+            }
+            return *this;
+        }
+
+        const PersistentNode<T>* operator*() const {
+            return queue.front();
+        }
+
+        const PersistentNode<T>* operator->() const {
+            return queue.front();
+        }
+    };
+
+    DFSIterator begin_dfs_scan() const { return DFSIterator(top.get()); }
+    DFSIterator end_dfs_scan() const { return DFSIterator(nullptr); }
+
+    BFSIterator begin_bfs_scan() const { return BFSIterator(top.get()); }
+    BFSIterator end_bfs_scan() const { return BFSIterator(nullptr); }
+
+private:
+    NodeRef top;
+
+    // Copy a pointer-based tree level by level, then fold the subtree sizes bottom-up
+    template <typename Summary>
+    static NodeRef copy(const Node<T, Summary>* root) {
+        if (!root) return NodeRef();
+        std::shared_ptr<PersistentNode<T>> result = std::make_shared<PersistentNode<T>>(root->value);
+        std::vector<const Node<T, Summary>*> sources(1, root);
+        std::vector<PersistentNode<T>*> copies(1, result.get());
+        std::vector<size_t> parents(1, 0);
+        for (size_t i = 0; i < sources.size(); ++i) {
+            for (const Node<T, Summary>* child : sources[i]->children) {
+                if (!child) continue;
+                std::shared_ptr<PersistentNode<T>> copied = std::make_shared<PersistentNode<T>>(child->value);
+                copies[i]->children.push_back(copied);
+                sources.push_back(child);
+                copies.push_back(copied.get());
+                parents.push_back(i);
+            }
+        }
+        for (size_t i = copies.size(); i-- > 1;) {
+            copies[parents[i]]->size += copies[i]->size;
+        }
+        return result;
+    }
+
+    // Replace the node at `path` with edit(node) (null removes it), copying the path above it
+    template <typename Edit>
+    void update(const Path& path, Edit edit) {
+        std::vector<const PersistentNode<T>*> trail;
+        const PersistentNode<T>* node = top.get();
+        for (size_t i = 0; node && i < path.size(); ++i) {
+            trail.push_back(node);
+            node = path[i] < node->children.size() ? node->children[path[i]].get() : nullptr;
+        }
+        if (!node) {
+            throw std::runtime_error("No node at the given path.");
+        }
+        NodeRef replacement = edit(*node);
+        size_t old_size = node->size;
+        size_t new_size = replacement ? replacement->size : 0;
+        for (size_t depth = trail.size(); depth-- > 0;) {
+            std::shared_ptr<PersistentNode<T>> changed = std::make_shared<PersistentNode<T>>(*trail[depth]);
+            if (replacement) {
+                changed->children[path[depth]] = replacement;
+            } else {
+                changed->children.erase(changed->children.begin() + static_cast<std::ptrdiff_t>(path[depth]));
+            }
+            changed->size = changed->size - old_size + new_size;
+            replacement = changed;
+            old_size = trail[depth]->size;
+            new_size = changed->size;
+        }
+        top = replacement;
+    }
+};
+
+#endif // PERSISTENT_TREE_HPP
@@ -0,0 +1,150 @@
+// minnesav@gmail.com
+
+#ifndef RENDER_QUEUE_HPP
+#define RENDER_QUEUE_HPP
+
+#include <cstdlib>
+#include <string>
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+/**
+ * @brief A bounded pool of background workers that run render commands.
+ *
+ * Commands (e.g. `dot -Tpng ...`) are queued by submit() and executed by at most
+ * max_workers threads at a time, so callers never block on Graphviz. flush()
+ * waits until every submitted command has finished.
+ */
+class RenderQueue {
+public:
+    /**
+     * @brief Returns the process-wide queue shared by all TreePrinter instances.
+     */
+    static RenderQueue& instance() {
+        static RenderQueue queue;
+        return queue;
+    }
+
+    /**
+     * @brief Constructs a queue that runs at most the given number of commands at once.
+     *
+     * @param workers The concurrency bound (0 picks the hardware concurrency).
+     */
+    explicit RenderQueue(size_t workers = 0)
+        : max_workers(workers ? workers : defaultWorkers()), active(0), failed(0), done(0), stopping(false) {}
+
+    /**
+     * @brief Waits for every queued command, then stops the workers.
+     */
+    ~RenderQueue() {
+        flush();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        job_ready.notify_all();
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+    }
+
+    RenderQueue(const RenderQueue&) = delete;
+    RenderQueue& operator=(const RenderQueue&) = delete;
+
+    /**
+     * @brief Queues a shell command and returns immediately.
+     *
+     * @param command The command to run on a worker thread.
+     */
+    void submit(const std::string& command) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            jobs.push_back(command);
+            if (workers.size() < max_workers) {
+                workers.push_back(std::thread(&RenderQueue::work, this));
+            }
+        }
+        job_ready.notify_one();
+    }
+
+    /**
+     * @brief Blocks until every submitted command has finished.
+     */
+    void flush() {
+        std::unique_lock<std::mutex> lock(mutex);
+        idle.wait(lock, [this] { return jobs.empty() && active == 0; });
+    }
+
+    /**
+     * @brief Changes the concurrency bound; takes effect for the next commands started.
+     *
+     * @param workers The new bound (0 picks the hardware concurrency).
+     */
+    void set_max_workers(size_t workers) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            max_workers = workers ? workers : defaultWorkers();
+        }
+        job_ready.notify_all();
+    }
+
+    /**
+     * @brief Number of commands that finished with a non-zero exit status.
+     */
+    size_t failures() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return failed;
+    }
+
+    /**
+     * @brief Number of commands that have finished, successfully or not.
+     */
+    size_t completed() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return done;
+    }
+
+private:
+    mutable std::mutex mutex;
+    std::condition_variable job_ready;  // A job was queued or the bound was raised
+    std::condition_variable idle;  // The queue drained and no job is running
+    std::deque<std::string> jobs;
+    std::vector<std::thread> workers;
+    size_t max_workers;
+    size_t active;  // Commands currently running
+    size_t failed;
+    size_t done;
+    bool stopping;
+
+    static size_t defaultWorkers() {
+        size_t hardware = std::thread::hardware_concurrency();
+        return hardware ? hardware : 2;
+    }
+
+    void work() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            job_ready.wait(lock, [this] { return stopping || (!jobs.empty() && active < max_workers); });
+            if (jobs.empty()) return;  // Stopping and nothing left to do
+            std::string command = jobs.front();
+            jobs.pop_front();
+            ++active;
+            lock.unlock();
+            int status = std::system(command.c_str());
+            lock.lock();
+            --active;
+            ++done;
+            if (status != 0) ++failed;
+            if (jobs.empty() && active == 0) {
+                idle.notify_all();
+            } else {
+                job_ready.notify_one();
+            }
+        }
+    }
+};
+
+#endif // RENDER_QUEUE_HPP
@@ -0,0 +1,366 @@
+// minnesav@gmail.com
+
+#ifndef SUCCINCT_TREE_HPP
+#define SUCCINCT_TREE_HPP
+
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include "node.hpp"
+
+/**
+ * @brief A static bit vector with constant-time rank and near-constant-time select.
+ *
+ * Ones are counted per 512-bit block (one 64-bit counter per block, 12.5% overhead).
+ * Select first jumps to the block named by a sample taken every 512 ones (or zeros),
+ * then binary-searches the few blocks up to the next sample and scans one block.
+ */
+class RankSelectBits {
+public:
+    RankSelectBits() : length(0) {}
+
+    /**
+     * @brief Appends a bit; call build() once all bits are in.
+     */
+    void push_back(bool bit) {
+        if (length % 64 == 0) words.push_back(0);
+        if (bit) words.back() |= uint64_t(1) << (length % 64);
+        ++length;
+    }
+
+    /**
+     * @brief Builds the rank counters and select samples.
+     */
+    void build() {
+        size_t block_count = (words.size() + words_per_block - 1) / words_per_block;
+        blocks.assign(block_count + 1, 0);
+        for (size_t b = 0; b < block_count; ++b) {
+            uint64_t ones = 0;
+            for (size_t w = b * words_per_block; w < std::min(words.size(), (b + 1) * words_per_block); ++w) {
+                ones += popcount(words[w]);
+            }
+            blocks[b + 1] = blocks[b] + ones;
+        }
+        one_samples.clear();
+        zero_samples.clear();
+        for (size_t b = 0; b < block_count; ++b) {
+            while (one_samples.size() * sample_rate < onesBefore(b + 1)) {
+                one_samples.push_back(static_cast<uint32_t>(b));
+            }
+            while (zero_samples.size() * sample_rate < zerosBefore(b + 1)) {
+                zero_samples.push_back(static_cast<uint32_t>(b));
+            }
+        }
+    }
+
+    size_t size() const {
+        return length;
+    }
+
+    bool get(size_t i) const {
+        return (words[i / 64] >> (i % 64)) & 1;
+    }
+
+    /**
+     * @brief Number of ones in positions [0, pos).
+     */
+    size_t rank1(size_t pos) const {
+        size_t block = pos / block_bits;
+        size_t rank = static_cast<size_t>(blocks[block]);
+        for (size_t w = block * words_per_block; w < pos / 64; ++w) {
+            rank += popcount(words[w]);
+        }
+        if (pos % 64) {
+            rank += popcount(words[pos / 64] & ((uint64_t(1) << (pos % 64)) - 1));
+        }
+        return rank;
+    }
+
+    /**
+     * @brief Number of zeros in positions [0, pos).
+     */
+    size_t rank0(size_t pos) const {
+        return pos - rank1(pos);
+    }
+
+    /**
+     * @brief Position of the k-th one, counting from 0.
+     */
+    size_t select1(size_t k) const {
+        if (k >= onesBefore(blocks.size() - 1)) {
+            throw std::out_of_range("select1 beyond the last one.");
+        }
+        return select(k, one_samples, true);
+    }
+
+    /**
+     * @brief Position of the k-th zero, counting from 0.
+     */
+    size_t select0(size_t k) const {
+        if (k >= zerosBefore(blocks.size() - 1)) {
+            throw std::out_of_range("select0 beyond the last zero.");
+        }
+        return select(k, zero_samples, false);
+    }
+
+    /**
+     * @brief Bytes used by the bits and their rank/select directories.
+     */
+    size_t memory_bytes() const {
+        return words.capacity() * sizeof(uint64_t) + blocks.capacity() * sizeof(uint64_t) +
+               (one_samples.capacity() + zero_samples.capacity()) * sizeof(uint32_t);
+    }
+
+private:
+    static const size_t words_per_block = 8;
+    static const size_t block_bits = words_per_block * 64;
+    static const size_t sample_rate = 512;
+
+    std::vector<uint64_t> words;
+    size_t length;
+    std::vector<uint64_t> blocks;  // Ones before each block, plus the total at the end
+    std::vector<uint32_t> one_samples;  // Block holding the (i * sample_rate)-th one
+    std::vector<uint32_t> zero_samples;  // Block holding the (i * sample_rate)-th zero
+
+    static size_t popcount(uint64_t word) {
+        return static_cast<size_t>(__builtin_popcountll(word));
+    }
+
+    size_t onesBefore(size_t block) const {
+        return static_cast<size_t>(blocks[block]);
+    }
+
+    size_t zerosBefore(size_t block) const {
+        return std::min(block * block_bits, length) - onesBefore(block);
+    }
+
+    size_t countBefore(size_t block, bool bit) const {
+        return bit ? onesBefore(block) : zerosBefore(block);
+    }
+
+    size_t select(size_t k, const std::vector<uint32_t>& samples, bool bit) const {
+        // Last block whose count before it is <= k, between this sample and the next
+        size_t sample = k / sample_rate;
+        size_t low = samples[sample];
+        size_t high = sample + 1 < samples.size() ? samples[sample + 1] : blocks.size() - 2;
+        while (low < high) {
+            size_t mid = (low + high + 1) / 2;
+            if (countBefore(mid, bit) <= k) {
+                low = mid;
+            } else {
+                high = mid - 1;
+            }
+        }
+        size_t remaining = k - countBefore(low, bit);
+        for (size_t w = low * words_per_block;; ++w) {
+            uint64_t word = bit ? words[w] : ~words[w];
+            size_t count = popcount(word);
+            if (remaining < count) {
+                for (size_t skip = 0; skip < remaining; ++skip) {
+                    word &= word - 1;  // Drop the lowest set bit
+                }
+                return w * 64 + static_cast<size_t>(__builtin_ctzll(word));
+            }
+            remaining -= count;
+        }
+    }
+};
+
+/**
+ * @brief Read-only tree in LOUDS form: about 2n bits of structure plus a value array.
+ *
+ * Nodes are numbered in BFS order (the root is 0). The structure is the level-order
+ * unary degree sequence "10" followed by 1^d 0 for every node, so parent, child, and
+ * degree are a rank or select away, and no per-node pointers or vectors are kept.
+ * LOUDS has no constant-time subtree size: subtree_size() walks the levels below the
+ * node, which is O(n) on a chain. MappedTreeView stores subtree sizes when that matters.
+ *
+ * @tparam T The type of the values stored in the tree nodes.
+ */
+template <typename T>
+class SuccinctTree {
+public:
+    static const size_t none = size_t(-1);
+
+    /**
+     * @brief Encodes the tree rooted at the given node.
+     *
+     * @param root The root of the tree (may be nullptr for an empty tree).
+     */
+    template <typename Summary>
+    explicit SuccinctTree(const Node<T, Summary>* root) {
+        std::vector<const Node<T, Summary>*> order;
+        if (root) {
+            order.push_back(root);
+            bits.push_back(true);  // Super-root pointing at the root
+            bits.push_back(false);
+        }
+        for (size_t i = 0; i < order.size(); ++i) {
+            for (const Node<T, Summary>* child : order[i]->children) {
+                if (!child) continue;
+                order.push_back(child);
+                bits.push_back(true);
+            }
+            bits.push_back(false);
+        }
+        values.reserve(order.size());
+        for (const Node<T, Summary>* node : order) {
+            values.push_back(node->value);
+        }
+        bits.build();
+    }
+
+    /**
+     * @brief Number of nodes in the tree.
+     */
+    size_t size() const {
+        return values.size();
+    }
+
+    /**
+     * @brief Value of node i.
+     */
+    const T& value(size_t i) const {
+        return values[i];
+    }
+
+    /**
+     * @brief Number of children of node i.
+     */
+    size_t degree(size_t i) const {
+        return bits.select0(i + 1) - bits.select0(i) - 1;
+    }
+
+    /**
+     * @brief Index of the k-th child of node i.
+     */
+    size_t child(size_t i, size_t k) const {
+        size_t start = bits.select0(i) + 1;
+        if (k >= bits.select0(i + 1) - start) {
+            throw std::out_of_range("Succinct tree node has no such child.");
+        }
+        return bits.rank1(start + k);
+    }
+
+    /**
+     * @brief Index of the parent of node i, or SuccinctTree::none for the root.
+     */
+    size_t parent(size_t i) const {
+        if (i == 0) return none;
+        return bits.rank0(bits.select1(i)) - 1;
+    }
+
+    /**
+     * @brief Number of nodes in the subtree of node i, in O(height of that subtree).
+     *
+     * A subtree covers one contiguous BFS range per level, so this takes one
+     * pair of selects per level below the node: cheap on bushy trees, but
+     * O(n) for the root of a chain. Calling it for every node of a deep tree
+     * is quadratic.
+     */
+    size_t subtree_size(size_t i) const {
+        size_t total = 0;
+        size_t first = i, last = i + 1;  // Half-open BFS range on the current level
+        while (first < last) {
+            total += last - first;
+            size_t next_first = bits.rank1(bits.select0(first));
+            size_t next_last = bits.rank1(bits.select0(last));
+            first = next_first;
+            last = next_last;
+        }
+        return total;
+    }
+
+    /**
+     * @brief Bytes used by the structure bits and their rank/select directories.
+     */
+    size_t structure_bytes() const {
+        return bits.memory_bytes();
+    }
+
+    // BFS Iterator: BFS order is index order
+    class BFSIterator {
+    private:
+        const SuccinctTree* tree;
+        size_t current;
+
+    public:
+        BFSIterator(const SuccinctTree* tree, size_t start) : tree(tree), current(start) {}
+
+        bool operator!=(const BFSIterator& other) const {
+            return current != other.current;
+        }
+
+        BFSIterator& operator++() {
+            ++current;
+            return *this;
+        }
+
+        const T& operator*() const {
+            return tree->value(current);
+        }
+
+        size_t index() const {
+            return current;
+        }
+    };
+
+    // DFS Iterator (pre-order): a node's children are a consecutive index range
+    class DFSIterator {
+    private:
+        const SuccinctTree* tree;
+        std::vector<size_t> stack;
+
+    public:
+        DFSIterator(const SuccinctTree* tree, bool at_begin) : tree(tree) {
+            if (at_begin && tree->size()) stack.push_back(0);
+        }
+
+        bool operator!=(const DFSIterator& other) const {
+            return stack.size() != other.stack.size() || (!stack.empty() && stack.back() != other.stack.back());
+        }
+
+        DFSIterator& operator++() {
+            size_t node = stack.back();
+            stack.pop_back();
+            size_t start = tree->bits.select0(node) + 1;
+            size_t count = tree->bits.select0(node + 1) - start;
+            if (count) {
+                size_t first = tree->bits.rank1(start);
+                for (size_t c = count; c-- > 0;) {
+                    stack.push_back(first + c);
+                }
+            }
+            return *this;
+        }
+
+        const T& operator*() const {
+            return tree->value(stack.back());
+        }
+
+        size_t index() const {
+            return stack.back();
+        }
+    };
+
+    typedef DFSIterator PreOrderIterator;
+
+    BFSIterator begin_bfs_scan() const { return BFSIterator(this, 0); }
+    BFSIterator end_bfs_scan() const { return BFSIterator(this, size()); }
+
+    DFSIterator begin_dfs_scan() const { return DFSIterator(this, true); }
+    DFSIterator end_dfs_scan() const { return DFSIterator(this, false); }
+
+    PreOrderIterator begin_pre_order() const { return begin_dfs_scan(); }
+    PreOrderIterator end_pre_order() const { return end_dfs_scan(); }
+
+private:
+    RankSelectBits bits;  // LOUDS sequence, 2n + 1 bits
+    std::vector<T> values;  // Values in BFS order
+};
+
+template <typename T>
+const size_t SuccinctTree<T>::none;
+
+#endif // SUCCINCT_TREE_HPP
@@ -0,0 +1,54 @@
+// minnesav@gmail.com
+
+#ifndef SUMMARY_HPP
+#define SUMMARY_HPP
+
+#include <cstddef>
+
+/**
+ * @brief Default summary policy for Tree: the structural hash, size and height of every subtree.
+ *
+ * A policy is the base class of Node, so its fields live in each node. Tree keeps
+ * them up to date along the changed path on every mutation and calls fold() after
+ * recomputing the structural fields, so a policy can add its own per-node data.
+ * size(), height(), operator==, diff() and compress() read these three fields.
+ */
+struct StructuralSummary {
+    size_t hash;  // Structural (Merkle) hash of the subtree, maintained by Tree
+    size_t size;  // Number of nodes in the subtree, maintained by Tree
+    size_t height;  // Number of levels in the subtree (1 for a leaf), maintained by Tree
+
+    template <typename T>
+    explicit StructuralSummary(const T&) : hash(0), size(1), height(1) {}
+
+    // Fold policy data over a node's children; the structural policy has none
+    template <typename NodeType, typename Combine>
+    static void fold(NodeType*, const Combine&) {}
+};
+
+/**
+ * @brief Summary policy that adds an aggregate: a user-supplied associative combine folded over every subtree.
+ *
+ * Opt in with Tree<T, K, Instrumentation, AggregateSummary<T>> and install the
+ * combine with Tree::set_aggregate(). Until a combine is installed, each node's
+ * aggregate is its own value.
+ *
+ * @tparam T The type of the values stored in the tree nodes.
+ */
+template <typename T>
+struct AggregateSummary : StructuralSummary {
+    T aggregate;  // The tree's combine folded over the subtree
+
+    explicit AggregateSummary(const T& value) : StructuralSummary(value), aggregate(value) {}
+
+    template <typename NodeType, typename Combine>
+    static void fold(NodeType* node, const Combine& combine) {
+        node->aggregate = node->value;
+        if (!combine) return;
+        for (const NodeType* child : node->children) {
+            if (child) node->aggregate = combine(node->aggregate, child->aggregate);
+        }
+    }
+};
+
+#endif // SUMMARY_HPP
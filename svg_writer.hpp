@@ -0,0 +1,100 @@
+// minnesav@gmail.com
+
+#ifndef SVG_WRITER_HPP
+#define SVG_WRITER_HPP
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "node.hpp"
+#include "buffered_writer.hpp"
+#include "tree_layout.hpp"
+
+/**
+ * @brief Draws a tree straight to an SVG file using the built-in TreeLayout.
+ *
+ * No Graphviz process is involved: layout is O(n) and the drawing is streamed
+ * through the same buffered output as the DOT exporter.
+ *
+ * @tparam T The type of the values stored in the tree nodes.
+ * @tparam Summary The summary policy of the nodes (see summary.hpp).
+ */
+template <typename T, typename Summary = StructuralSummary>
+class SvgWriter : public BufferedWriter<T> {
+public:
+    /**
+     * @brief Opens the SVG file for writing.
+     *
+     * @param filename The path of the SVG file.
+     * @param buffer_size The size of the output buffer in bytes.
+     */
+    explicit SvgWriter(const std::string& filename, size_t buffer_size = 1 << 20)
+        : BufferedWriter<T>(filename, BufferedWriter<T>::Escape::Xml, buffer_size) {}
+
+    /**
+     * @brief Lays out and draws the tree rooted at the given node.
+     *
+     * @param root The root of the tree (may be nullptr for an empty drawing).
+     */
+    void write(const Node<T, Summary>* root) {
+        TreeLayout<T, Summary> layout;
+        std::vector<typename TreeLayout<T, Summary>::Placement> placements = layout.compute(root);
+
+        double width = 0.0, height = 0.0;
+        for (const auto& placement : placements) {
+            width = std::max(width, px(placement.x));
+            height = std::max(height, py(placement.depth));
+        }
+        this->put("<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"");
+        this->putFixed(width + margin);
+        this->put("\" height=\"");
+        this->putFixed(height + margin);
+        this->put("\" font-family=\"sans-serif\" font-size=\"12\" text-anchor=\"middle\">\n");
+
+        // Edges first so the node circles are drawn over them
+        this->put("<g stroke=\"black\">\n");
+        for (const auto& placement : placements) {
+            if (placement.parent == size_t(-1)) continue;
+            const auto& parent = placements[placement.parent];
+            this->put("<line x1=\"");
+            this->putFixed(px(parent.x));
+            this->put("\" y1=\"");
+            this->putFixed(py(parent.depth));
+            this->put("\" x2=\"");
+            this->putFixed(px(placement.x));
+            this->put("\" y2=\"");
+            this->putFixed(py(placement.depth));
+            this->put("\"/>\n");
+        }
+        this->put("</g>\n<g fill=\"white\" stroke=\"black\">\n");
+        for (const auto& placement : placements) {
+            this->put("<circle cx=\"");
+            this->putFixed(px(placement.x));
+            this->put("\" cy=\"");
+            this->putFixed(py(placement.depth));
+            this->put("\" r=\"18\"/>\n");
+        }
+        this->put("</g>\n<g>\n");
+        for (const auto& placement : placements) {
+            this->put("<text x=\"");
+            this->putFixed(px(placement.x));
+            this->put("\" y=\"");
+            this->putFixed(py(placement.depth) + 4.0);
+            this->put("\">");
+            this->putValue(placement.node->value);
+            this->put("</text>\n");
+        }
+        this->put("</g>\n</svg>\n");
+        this->drain();
+    }
+
+private:
+    static constexpr double margin = 30.0;  // Space around the drawing
+    static constexpr double spacing = 50.0;  // Horizontal distance between neighbouring nodes
+    static constexpr double level = 70.0;  // Vertical distance between levels
+
+    static double px(double x) { return margin + x * spacing; }
+    static double py(size_t depth) { return margin + static_cast<double>(depth) * level; }
+};
+
+#endif // SVG_WRITER_HPP
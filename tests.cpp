@@ -1,9 +1,15 @@
 // minnesav@gmail.com
 
 #include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
 #include <cassert>
+#include <cmath>
+#include <cstring>
 #include "tree.hpp"
 #include "complex.hpp"
+#include "concurrent_tree.hpp"
 
 // Function to test adding a root to the tree
 void test_add_root() {
@@ -530,6 +536,1689 @@ void test_complex_to_string() {
     std::cout << "test_complex_to_string passed!" << std::endl;
 }
 
+// Helper: grow a complete binary subtree whose node values are their depth
+void grow_levels(Node<int>* node, int depth, int max_depth) {
+    if (depth == max_depth) return;
+    for (int i = 0; i < 2; ++i) {
+        Node<int>* child = new Node<int>(depth + 1);
+        node->add_child(child);
+        grow_levels(child, depth + 1, max_depth);
+    }
+}
+
+// Function to test hash-consing identical subtrees
+void test_compress_expand() {
+    std::cout << "Running test_compress_expand..." << std::endl;
+    Tree<int> tree;
+    Node<int> root_node(0);
+    tree.add_root(root_node);
+    grow_levels(tree.getRoot(), 0, 4);  // 31 nodes, one distinct subtree per level
+
+    std::vector<int> before;
+    for (auto it = tree.begin_pre_order(); it != tree.end_pre_order(); ++it) {
+        before.push_back((*it)->get_value());
+    }
+    assert(tree.node_count() == 31);
+
+    tree.compress();
+    assert(tree.is_compressed());
+    assert(tree.node_count() == 5);
+    assert(tree.getRoot()->children[0] == tree.getRoot()->children[1]);
+
+    std::vector<int> shared;
+    for (auto it = tree.begin_pre_order(); it != tree.end_pre_order(); ++it) {
+        shared.push_back((*it)->get_value());
+    }
+    assert(shared == before);
+
+    tree.expand();
+    assert(!tree.is_compressed());
+    assert(tree.node_count() == 31);
+    assert(tree.getRoot()->children[0] != tree.getRoot()->children[1]);
+
+    // Mutating a compressed tree transparently expands it first
+    tree.compress();
+    Node<int> leaf(4);
+    Node<int> extra(5);
+    tree.add_sub_node(leaf, extra);
+    assert(!tree.is_compressed());
+    assert(tree.node_count() == 32);
+    std::cout << "test_compress_expand passed!" << std::endl;
+}
+
+// Helper: build the 1..n tree in BFS order through add_sub_node
+template <int K, typename Instrumentation, typename Summary>
+void build_bfs_tree(Tree<int, K, Instrumentation, Summary>& tree, int n) {
+    typedef typename Tree<int, K, Instrumentation, Summary>::NodeType NodeType;
+    NodeType root_node(1);
+    tree.add_root(root_node);
+    for (int i = 2; i <= n; ++i) {
+        NodeType parent((i - 2) / K + 1);
+        NodeType child(i);
+        tree.add_sub_node(parent, child);
+    }
+}
+
+// A value type whose hash ignores the value, so that any two same-shaped trees collide
+struct Colliding {
+    int value;
+
+    bool operator==(const Colliding& other) const { return value == other.value; }
+};
+
+namespace std {
+template <>
+struct hash<Colliding> {
+    size_t operator()(const Colliding&) const { return 0; }
+};
+}
+
+// Function to test Merkle hashes, hash-checked equality and diff
+void test_merkle_diff() {
+    std::cout << "Running test_merkle_diff..." << std::endl;
+    Tree<int, 3> a;
+    Tree<int, 3> b;
+    build_bfs_tree(a, 20);
+    build_bfs_tree(b, 20);
+    assert(a == b);
+    assert(diff(a, b).empty());
+
+    // Incremental hashes agree with a full recomputation
+    size_t incremental = a.structural_hash();
+    a.refresh();
+    assert(a.structural_hash() == incremental);
+
+    // Sibling order is part of the structure
+    Tree<int, 3> swapped;
+    build_bfs_tree(swapped, 20);
+    std::swap(swapped.getRoot()->children[0], swapped.getRoot()->children[1]);
+    swapped.getRoot()->children[0]->sibling_index = 0;
+    swapped.getRoot()->children[1]->sibling_index = 1;
+    swapped.refresh();
+    assert(a != swapped && !a.deep_equal(swapped));
+
+    // A real collision: values whose std::hash agrees give equal Merkle hashes, which == and diff() trust
+    Tree<Colliding, 2> left;
+    Tree<Colliding, 2> right;
+    for (int i = 1; i <= 7; ++i) {
+        Node<Colliding> parent(Colliding{i / 2});
+        Node<Colliding> child_left(Colliding{i});
+        Node<Colliding> child_right(Colliding{i * 10});
+        if (i == 1) {
+            left.add_root(child_left);
+            right.add_root(child_right);
+        } else {
+            left.add_sub_node(parent, child_left);
+            Node<Colliding> parent_right(Colliding{i / 2 * 10});
+            right.add_sub_node(parent_right, child_right);
+        }
+    }
+    assert(left.structural_hash() == right.structural_hash());
+    assert(left == right && diff(left, right).empty());
+    assert(!left.deep_equal(right));  // Only the walk sees the different values
+    assert(a.deep_equal(b));
+
+    Node<int> parent(20);
+    Node<int> child(21);
+    b.add_sub_node(parent, child);
+    assert(a != b);
+    std::vector<NodeDiff<int>> changes = diff(a, b);
+    assert(changes.size() == 1);
+    assert(changes[0].kind == DiffKind::Added);
+    assert(changes[0].after->get_value() == 21);
+
+    b.getRoot()->children[1]->value = 99;
+    b.refresh();
+    changes = diff(a, b);
+    assert(changes.size() == 2);
+    assert(changes[0].kind == DiffKind::Added);  // Node 21 under 20, found first in pre-order
+    assert(changes[1].kind == DiffKind::Changed);
+    assert(changes[1].before->get_value() == 3 && changes[1].after->get_value() == 99);
+
+    // myHeap leaves the hashes consistent with the new shape
+    b.myHeap();
+    incremental = b.structural_hash();
+    b.refresh();
+    assert(b.structural_hash() == incremental);
+    std::cout << "test_merkle_diff passed!" << std::endl;
+}
+
+// Function to test size, height and custom aggregate summaries
+void test_subtree_summaries() {
+    std::cout << "Running test_subtree_summaries..." << std::endl;
+    typedef Tree<int, 2, NoInstrumentation, AggregateSummary<int>> SummedTree;
+    SummedTree tree;
+    assert(tree.size() == 0 && tree.height() == 0);
+    tree.set_aggregate([](const int& a, const int& b) { return a + b; });
+    build_bfs_tree(tree, 10);
+
+    assert(tree.size() == 10);
+    assert(tree.height() == 4);
+    assert(tree.aggregate() == 55);
+    SummedTree::NodeType* two = tree.find(tree.getRoot(), 2);
+    assert(two->size == 6);  // 2, 4, 5, 8, 9, 10
+    assert(two->height == 3);
+    assert(two->aggregate == 38);
+
+    // A new combine recomputes every aggregate
+    tree.set_aggregate([](const int& a, const int& b) { return std::max(a, b); });
+    assert(tree.aggregate() == 10);
+    assert(tree.find(tree.getRoot(), 3)->aggregate == 7);
+
+    tree.myHeap();
+    assert(tree.size() == 10);
+    assert(tree.height() == 4);
+    assert(tree.aggregate() == 10);
+
+    // Aggregates are opt-in: the default node carries no second copy of the value
+    assert(sizeof(Node<std::string>) + sizeof(std::string) == sizeof(Node<std::string, AggregateSummary<std::string>>));
+
+    // Without a combine, every aggregate is the node's own value, also after values move
+    SummedTree plain;
+    build_bfs_tree(plain, 10);
+    assert(plain.aggregate() == 1);
+    plain.myHeap();
+    for (auto it = plain.begin_pre_order(); it != plain.end_pre_order(); ++it) {
+        assert((*it)->aggregate == (*it)->value);
+    }
+    std::cout << "test_subtree_summaries passed!" << std::endl;
+}
+
+// Function to test ancestor, LCA and depth queries
+void test_lca_index() {
+    std::cout << "Running test_lca_index..." << std::endl;
+    Tree<int, 3> tree;
+    build_bfs_tree(tree, 20);
+    Node<int>* root_ptr = tree.getRoot();
+    Node<int>* n5 = tree.find(root_ptr, 5);
+    Node<int>* n6 = tree.find(root_ptr, 6);
+    Node<int>* n14 = tree.find(root_ptr, 14);
+    Node<int>* n20 = tree.find(root_ptr, 20);
+    Node<int>* n9 = tree.find(root_ptr, 9);
+
+    assert(tree.depth(root_ptr) == 0);
+    assert(tree.depth(n20) == 3);
+    assert(tree.is_ancestor(root_ptr, n20));
+    assert(tree.is_ancestor(n20, n20));
+    assert(!tree.is_ancestor(n20, root_ptr));
+    assert(!tree.is_ancestor(n6, n20));
+    assert(tree.lca(n14, n20)->get_value() == 2);
+    assert(tree.lca(n5, n6)->get_value() == 2);
+    assert(tree.lca(n20, n9)->get_value() == 1);
+    assert(tree.lca(n5, n14) == n5);
+
+    // The index is rebuilt after a mutation
+    Node<int> parent(20);
+    Node<int> child(21);
+    tree.add_sub_node(parent, child);
+    Node<int>* n21 = tree.find(root_ptr, 21);
+    assert(tree.depth(n21) == 4);
+    assert(tree.lca(n21, n14)->get_value() == 2);
+
+    Node<int> outsider(0);
+    bool thrown = false;
+    try {
+        tree.depth(&outsider);
+    } catch (const std::runtime_error&) {
+        thrown = true;
+    }
+    assert(thrown);
+    std::cout << "test_lca_index passed!" << std::endl;
+}
+
+// Helper: collect node values between two iterators
+template <typename Iterator>
+std::vector<int> collect_values(Iterator it, Iterator end) {
+    std::vector<int> values;
+    for (; it != end; ++it) {
+        values.push_back((*it)->get_value());
+    }
+    return values;
+}
+
+// Function to test the parent-link (stackless) iterators against the stack-based ones
+void test_stackless_iterators() {
+    std::cout << "Running test_stackless_iterators..." << std::endl;
+    Tree<int, 2> binary;
+    build_bfs_tree(binary, 12);
+    assert(collect_values(binary.begin_stackless_pre_order(), binary.end_stackless_pre_order()) ==
+           collect_values(binary.begin_pre_order(), binary.end_pre_order()));
+    assert(collect_values(binary.begin_stackless_post_order(), binary.end_stackless_post_order()) ==
+           collect_values(binary.begin_post_order(), binary.end_post_order()));
+    assert(collect_values(binary.begin_stackless_in_order(), binary.end_stackless_in_order()) ==
+           collect_values(binary.begin_in_order(), binary.end_in_order()));
+    assert(collect_values(binary.begin_stackless_dfs_scan(), binary.end_stackless_dfs_scan()) ==
+           collect_values(binary.begin_dfs_scan(), binary.end_dfs_scan()));
+
+    Tree<int, 3> ternary;
+    build_bfs_tree(ternary, 20);
+    assert(collect_values(ternary.begin_stackless_pre_order(), ternary.end_stackless_pre_order()) ==
+           collect_values(ternary.begin_pre_order(), ternary.end_pre_order()));
+    assert(collect_values(ternary.begin_stackless_post_order(), ternary.end_stackless_post_order()) ==
+           collect_values(ternary.begin_post_order(), ternary.end_post_order()));
+
+    // The sibling index shares the padding after a 4-byte value, so the links cost one pointer
+    assert(sizeof(Node<int>) ==
+           sizeof(StructuralSummary) + 2 * sizeof(int) + sizeof(std::vector<Node<int>*>) + sizeof(Node<int>*));
+
+    // Parent links survive myHeap
+    ternary.myHeap();
+    assert(collect_values(ternary.begin_stackless_post_order(), ternary.end_stackless_post_order()) ==
+           collect_values(ternary.begin_post_order(), ternary.end_post_order()));
+
+    Tree<int, 3> path_tree;
+    build_bfs_tree(path_tree, 20);
+    std::vector<Node<int>*> path = path_tree.path_to_root(path_tree.find(path_tree.getRoot(), 20));
+    assert(path.size() == 4);
+    assert(path[0]->get_value() == 1 && path[1]->get_value() == 2);
+    assert(path[2]->get_value() == 7 && path[3]->get_value() == 20);
+    std::cout << "test_stackless_iterators passed!" << std::endl;
+}
+
+// Helper: read a whole file into a string
+std::string read_file(const std::string& filename) {
+    std::ifstream file(filename, std::ios::binary);
+    std::stringstream contents;
+    contents << file.rdbuf();
+    return contents.str();
+}
+
+// Function to test the buffered DOT export with index-based node identities
+void test_dot_export() {
+    std::cout << "Running test_dot_export..." << std::endl;
+    Tree<int> tree;
+    Node<int> root_node(1);
+    Node<int> dup(5);
+    Node<int> negative(-7);
+    tree.add_root(root_node);
+    tree.add_sub_node(root_node, dup);
+    tree.add_sub_node(root_node, dup);  // Same value twice: must stay two graph nodes
+    tree.add_sub_node(dup, negative);
+
+    TreePrinter<int, 2> printer;
+    printer.write_dot(tree, "test_export.dot");
+    std::string dot = read_file("test_export.dot");
+    std::remove("test_export.dot");
+    assert(dot == "digraph G {\nnode [shape=circle];\n"
+                  "n0 [label=\"1\"];\n"
+                  "n1 [label=\"5\"];\nn0 -> n1;\n"
+                  "n2 [label=\"-7\"];\nn1 -> n2;\n"
+                  "n3 [label=\"5\"];\nn0 -> n3;\n"
+                  "}\n");
+
+    Tree<std::string> s_tree;
+    Node<std::string> quoted("say \"hi\"");
+    s_tree.add_root(quoted);
+    TreePrinter<std::string, 2> string_printer;
+    string_printer.write_dot(s_tree, "test_export.dot");
+    dot = read_file("test_export.dot");
+    std::remove("test_export.dot");
+    assert(dot.find("n0 [label=\"say \\\"hi\\\"\"];") != std::string::npos);
+    std::cout << "test_dot_export passed!" << std::endl;
+}
+
+// Function to test the asynchronous render queue and DOT-only printing
+void test_render_queue() {
+    std::cout << "Running test_render_queue..." << std::endl;
+    RenderQueue queue(2);
+    for (int i = 0; i < 4; ++i) {
+        queue.submit("true");
+    }
+    queue.submit("false");
+    queue.flush();
+    assert(queue.completed() == 5);
+    assert(queue.failures() == 1);
+
+    // DOT-only mode writes the DOT file and queues nothing
+    Tree<int> tree;
+    build_bfs_tree(tree, 5);
+    TreePrinter<int, 2> printer;
+    printer.set_dot_only(true);
+    size_t before = RenderQueue::instance().completed();
+    printer.print(tree, "test_render.dot", "test_render.png");
+    printer.flush();
+    assert(RenderQueue::instance().completed() == before);
+    assert(read_file("test_render.dot").find("n3 [label=\"5\"];") != std::string::npos);
+    std::remove("test_render.dot");
+    std::cout << "test_render_queue passed!" << std::endl;
+}
+
+// Function to test the built-in tidy layout and SVG output
+void test_layout_svg() {
+    std::cout << "Running test_layout_svg..." << std::endl;
+    Tree<int, 3> tree;
+    build_bfs_tree(tree, 30);
+    Node<int> deep_parent(30);
+    Node<int> deep_child(31);
+    tree.add_sub_node(deep_parent, deep_child);
+
+    TreeLayout<int> layout;
+    std::vector<TreeLayout<int>::Placement> placements = layout.compute(tree.getRoot());
+    assert(placements.size() == 31);
+    for (size_t i = 0; i < placements.size(); ++i) {
+        // Nodes on the same level are at least one unit apart
+        for (size_t j = i + 1; j < placements.size(); ++j) {
+            if (placements[i].depth == placements[j].depth) {
+                assert(std::fabs(placements[i].x - placements[j].x) >= 1.0 - 1e-9);
+            }
+        }
+        // Parents are centred over their first and last child
+        std::vector<double> kids;
+        for (size_t j = 0; j < placements.size(); ++j) {
+            if (placements[j].parent == i) kids.push_back(placements[j].x);
+        }
+        if (!kids.empty()) {
+            assert(std::fabs(placements[i].x - (kids.front() + kids.back()) / 2.0) < 1e-9);
+        }
+    }
+
+    TreePrinter<int, 3> printer;
+    printer.print_svg(tree, "test_layout.svg");
+    std::string svg = read_file("test_layout.svg");
+    std::remove("test_layout.svg");
+    size_t circles = 0;
+    for (size_t pos = svg.find("<circle"); pos != std::string::npos; pos = svg.find("<circle", pos + 1)) {
+        ++circles;
+    }
+    assert(circles == 31);
+    assert(svg.find(">31</text>") != std::string::npos);
+    std::cout << "test_layout_svg passed!" << std::endl;
+}
+
+// Function to test level-of-detail DOT export
+void test_render_options() {
+    std::cout << "Running test_render_options..." << std::endl;
+    Tree<int, 2> tree;
+    build_bfs_tree(tree, 15);  // Complete binary tree, 4 levels
+    TreePrinter<int, 2> printer;
+
+    RenderOptions depth_cut;
+    depth_cut.max_depth = 1;
+    printer.write_dot(tree, "test_lod.dot", depth_cut);
+    std::string dot = read_file("test_lod.dot");
+    assert(dot == "digraph G {\nnode [shape=circle];\n"
+                  "n0 [label=\"1\"];\n"
+                  "n1 [label=\"2\"];\nn0 -> n1;\n"
+                  "n2 [label=\"3\"];\nn0 -> n2;\n"
+                  "n3 [label=\"+6\", shape=box];\nn1 -> n3;\n"
+                  "n4 [label=\"+6\", shape=box];\nn2 -> n4;\n"
+                  "}\n");
+
+    RenderOptions collapse;
+    collapse.collapse_threshold = 3;  // Subtrees of 7 nodes collapse, subtrees of 3 do not
+    printer.write_dot(tree, "test_lod.dot", collapse);
+    dot = read_file("test_lod.dot");
+    assert(dot.find("n1 [label=\"+7\", shape=box];") != std::string::npos);
+    assert(dot.find("n2 [label=\"+7\", shape=box];") != std::string::npos);
+    assert(dot.find("n3 ") == std::string::npos);
+
+    RenderOptions budget;
+    budget.max_nodes = 5;
+    printer.write_dot(tree, "test_lod.dot", budget);
+    dot = read_file("test_lod.dot");
+    std::remove("test_lod.dot");
+    size_t real = 0;
+    size_t hidden = 0;
+    for (size_t pos = dot.find("[label=\""); pos != std::string::npos; pos = dot.find("[label=\"", pos + 1)) {
+        if (dot[pos + 8] == '+') {
+            hidden += std::stoul(dot.substr(pos + 9));
+        } else {
+            ++real;
+        }
+    }
+    assert(real == 5);
+    assert(real + hidden == 15);  // Every node is either drawn or counted in a summary
+    std::cout << "test_render_options passed!" << std::endl;
+}
+
+// Helper: replace a file's contents with the given bytes
+void write_file(const std::string& path, const std::string& bytes) {
+    std::ofstream out(path.c_str(), std::ios::binary | std::ios::trunc);
+    out.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+}
+
+// Helper: whether loading the file into the tree throws
+template <typename Tree>
+bool load_fails(Tree& tree, const std::string& path) {
+    try {
+        tree.load(path);
+    } catch (const std::runtime_error&) {
+        return true;
+    }
+    return false;
+}
+
+// Function to test binary save/load and the zero-copy mapped view
+void test_binary_serialization() {
+    std::cout << "Running test_binary_serialization..." << std::endl;
+    Tree<int, 3> tree;
+    build_bfs_tree(tree, 40);
+    tree.save("test_tree.ktree");
+
+    {
+        MappedTreeView<int> view("test_tree.ktree");
+        assert(view.size() == 40);
+        assert(view.value(0) == 1);
+        assert(view.child_count(0) == 3);
+        assert(view.subtree_size(0) == 40);
+        size_t third = view.child(0, 2);
+        assert(view.value(third) == 4);
+        assert(view.subtree_size(third) == tree.find(tree.getRoot(), 4)->size);
+        // The index order is the pre-order
+        std::vector<int> pre_order = collect_values(tree.begin_pre_order(), tree.end_pre_order());
+        for (size_t i = 0; i < view.size(); ++i) {
+            assert(view.value(i) == pre_order[i]);
+        }
+    }
+
+    Tree<int, 3> loaded;
+    loaded.load("test_tree.ktree");
+    assert(loaded == tree);
+    assert(loaded.size() == 40);
+    assert(diff(tree, loaded).empty());
+
+    Tree<int, 2> narrow;
+    bool thrown = false;
+    try {
+        narrow.load("test_tree.ktree");  // Three children do not fit a binary tree
+    } catch (const std::runtime_error&) {
+        thrown = true;
+    }
+    assert(thrown);
+    std::remove("test_tree.ktree");
+
+    Tree<std::string> s_tree;
+    Node<std::string> alpha("alpha");
+    Node<std::string> beta("beta");
+    Node<std::string> empty("");
+    s_tree.add_root(alpha);
+    s_tree.add_sub_node(alpha, beta);
+    s_tree.add_sub_node(alpha, empty);
+    s_tree.save("test_tree.ktree");
+    Tree<std::string> s_loaded;
+    s_loaded.load("test_tree.ktree");
+    std::remove("test_tree.ktree");
+    assert(s_loaded == s_tree);
+    assert(s_loaded.getRoot()->children[0]->get_value() == "beta");
+    assert(s_loaded.getRoot()->children[1]->get_value() == "");
+
+    // Truncated and corrupt files are rejected, the partial tree is freed and the target is untouched
+    tree.save("test_tree.ktree");
+    std::string bytes = read_file("test_tree.ktree");
+    write_file("test_tree.ktree", bytes.substr(0, bytes.size() / 2));
+    assert(load_fails(loaded, "test_tree.ktree"));
+    std::string corrupt = bytes;
+    corrupt[sizeof(TreeFileHeader) + 39] = 1;  // The last node in pre-order is a leaf; promise it a child
+    write_file("test_tree.ktree", corrupt);
+    assert(load_fails(loaded, "test_tree.ktree"));
+    assert(loaded == tree);
+
+    s_tree.save("test_tree.ktree");
+    corrupt = read_file("test_tree.ktree");
+    uint64_t offset = 1 << 20;  // Far past the end of the file
+    std::memcpy(&corrupt[sizeof(TreeFileHeader) + 8 + 16 + sizeof(uint64_t)], &offset, sizeof(offset));
+    write_file("test_tree.ktree", corrupt);
+    assert(load_fails(s_loaded, "test_tree.ktree"));
+    {
+        MappedTreeView<std::string> view("test_tree.ktree");
+        assert(view.value(0) == "alpha");
+        thrown = false;
+        try {
+            view.value(1);
+        } catch (const std::runtime_error&) {
+            thrown = true;
+        }
+        assert(thrown);
+    }
+    std::remove("test_tree.ktree");
+    assert(s_loaded == s_tree);
+
+    // A value type of the same size but a different kind is refused
+    Tree<float> floats;
+    Node<float> half(0.5f);
+    floats.add_root(half);
+    floats.save("test_tree.ktree");
+    Tree<int> ints;
+    assert(load_fails(ints, "test_tree.ktree"));
+    Tree<unsigned> unsigneds;
+    assert(load_fails(unsigneds, "test_tree.ktree"));
+    Tree<float> floats_loaded;
+    floats_loaded.load("test_tree.ktree");
+    assert(floats_loaded.getRoot()->get_value() == 0.5f);
+    Tree<double> doubles;
+    Node<double> quarter(0.25);
+    doubles.add_root(quarter);
+    doubles.save("test_tree.ktree");
+    Tree<long long> longs;
+    assert(load_fails(longs, "test_tree.ktree"));
+    ints.add_root(*tree.getRoot());
+    ints.save("test_tree.ktree");
+    assert(load_fails(unsigneds, "test_tree.ktree"));
+
+    // More than 255 children switch the child counts to 32 bits
+    Tree<int, 1000> wide;
+    Node<int> hub(0);
+    wide.add_root(hub);
+    for (int i = 1; i <= 300; ++i) {
+        wide.add_sub_node(wide.getRoot(), i);
+    }
+    wide.add_sub_node(wide.find(wide.getRoot(), 300), 301);
+    wide.save("test_tree.ktree");
+    {
+        MappedTreeView<int> view("test_tree.ktree");
+        assert(view.child_count(0) == 300);
+        assert(view.child_count(300) == 1 && view.value(view.child(300, 0)) == 301);
+    }
+    Tree<int, 1000> wide_loaded;
+    wide_loaded.load("test_tree.ktree");
+    assert(wide_loaded == wide && wide_loaded.deep_equal(wide));
+    std::remove("test_tree.ktree");
+    std::cout << "test_binary_serialization passed!" << std::endl;
+}
+
+// Function to test importing edge lists and DOT files
+void test_import() {
+    std::cout << "Running test_import..." << std::endl;
+    {
+        std::ofstream edges("test_import.txt");
+        edges << "# parent child\n1 2\n1 3\n\n2 4\n2 -> 5\n3 6\r\n";
+    }
+    Tree<int, 2> tree;
+    tree.import_edge_list("test_import.txt");
+    Tree<int, 2> expected;
+    build_bfs_tree(expected, 6);
+    assert(tree == expected);
+    assert(tree.size() == 6);
+
+    // Round trip through TreePrinter's own DOT output, duplicates and negatives included
+    Tree<double, 3> doubles;
+    Node<double> root_node(3.1);
+    Node<double> dup(-2.5);
+    doubles.add_root(root_node);
+    doubles.add_sub_node(root_node, dup);
+    doubles.add_sub_node(root_node, dup);
+    doubles.add_sub_node(dup, root_node);
+    TreePrinter<double, 3> printer;
+    printer.write_dot(doubles, "test_import.dot");
+    Tree<double, 3> reread;
+    reread.import_dot("test_import.dot");
+    assert(reread == doubles);
+
+    // The value-named form, with escaped quotes in string names
+    {
+        std::ofstream dot("test_import.dot");
+        dot << "digraph G {\nnode [shape=circle];\n\"alpha\" -> \"beta\";\n\"alpha\" -> \"say \\\"hi\\\"\";\n}\n";
+    }
+    Tree<std::string> s_tree;
+    s_tree.import_dot("test_import.dot");
+    assert(s_tree.getRoot()->get_value() == "alpha");
+    assert(s_tree.getRoot()->children[1]->get_value() == "say \"hi\"");
+
+    // Inputs that are not trees are rejected
+    {
+        std::ofstream edges("test_import.txt");
+        edges << "1 2\n3 2\n";
+    }
+    bool thrown = false;
+    try {
+        tree.import_edge_list("test_import.txt");
+    } catch (const std::runtime_error&) {
+        thrown = true;
+    }
+    assert(thrown);
+    assert(tree.size() == 6);  // A failed import leaves the tree untouched
+
+    // Integer labels must fit the value type
+    {
+        std::ofstream edges("test_import.txt");
+        edges << "2147483647 -2147483648\n";
+    }
+    tree.import_edge_list("test_import.txt");
+    assert(tree.getRoot()->get_value() == 2147483647 && tree.getRoot()->children[0]->get_value() == -2147483647 - 1);
+    const char* out_of_range[] = {"1 2147483648\n", "1 -2147483649\n", "1 99999999999999999999999\n"};
+    for (const char* text : out_of_range) {
+        {
+            std::ofstream edges("test_import.txt");
+            edges << text;
+        }
+        thrown = false;
+        try {
+            tree.import_edge_list("test_import.txt");
+        } catch (const std::runtime_error&) {
+            thrown = true;
+        }
+        assert(thrown);
+    }
+    Tree<unsigned char, 2> bytes;
+    {
+        std::ofstream edges("test_import.txt");
+        edges << "255 -0\n";
+    }
+    bytes.import_edge_list("test_import.txt");
+    assert(bytes.getRoot()->get_value() == 255 && bytes.getRoot()->children[0]->get_value() == 0);
+    {
+        std::ofstream edges("test_import.txt");
+        edges << "255 -1\n";
+    }
+    thrown = false;
+    try {
+        bytes.import_edge_list("test_import.txt");
+    } catch (const std::runtime_error&) {
+        thrown = true;
+    }
+    assert(thrown);
+
+    // A chain far past the initial name table, which then grows as names arrive
+    {
+        std::ofstream edges("test_import.txt");
+        for (int i = 1; i < 5000; ++i) {
+            edges << i << " " << i + 1 << "\n";
+        }
+    }
+    Tree<int, 1> chain;
+    chain.import_edge_list("test_import.txt");
+    assert(chain.size() == 5000 && chain.height() == 5000);
+    std::remove("test_import.txt");
+    std::remove("test_import.dot");
+    std::cout << "test_import passed!" << std::endl;
+}
+
+// Function to test moving subtrees with detach, attach and erase
+void test_detach_attach_erase() {
+    std::cout << "Running test_detach_attach_erase..." << std::endl;
+    typedef Tree<int, 3, NoInstrumentation, AggregateSummary<int>> SummedTree;
+    SummedTree tree;
+    build_bfs_tree(tree, 13);
+    tree.set_aggregate([](const int& a, const int& b) { return a + b; });
+    SummedTree::NodeType* two = tree.find(tree.getRoot(), 2);
+    SummedTree::NodeType* six = tree.find(tree.getRoot(), 6);
+
+    // The detached nodes keep their identity and summaries
+    SummedTree branch = tree.detach(two);
+    assert(branch.getRoot() == two);
+    assert(two->parent == nullptr);
+    assert(branch.size() == 4);
+    assert(branch.aggregate() == 2 + 5 + 6 + 7);
+    assert(tree.size() == 9);
+    assert(tree.aggregate() == 91 - 20);
+    assert(tree.getRoot()->children[0]->get_value() == 3);
+    assert(tree.getRoot()->children[1]->sibling_index == 1);
+    assert(tree.find(tree.getRoot(), 6) == nullptr);
+
+    SummedTree::NodeType* thirteen = tree.find(tree.getRoot(), 13);
+    tree.attach(thirteen, branch);
+    assert(branch.size() == 0);
+    assert(two->parent == thirteen);
+    assert(tree.size() == 13);
+    assert(tree.aggregate() == 91);
+    assert(tree.lca(six, thirteen) == thirteen);
+    assert(tree.depth(six) == 4);
+    std::vector<int> dfs = collect_values(tree.begin_stackless_dfs_scan(), tree.end_stackless_dfs_scan());
+    assert(dfs == std::vector<int>({1, 3, 8, 9, 10, 4, 11, 12, 13, 2, 5, 6, 7}));
+
+    // Foreign nodes (checked in debug builds only), full parents and self-attachment are refused
+    SummedTree other;
+    build_bfs_tree(other, 2);
+    int refused = 0;
+#ifndef NDEBUG
+    try { tree.detach(other.getRoot()); } catch (const std::runtime_error&) { ++refused; }
+#else
+    ++refused;
+#endif
+    try { tree.attach(tree.getRoot(), tree); } catch (const std::runtime_error&) { ++refused; }
+    try { tree.attach(two, other); } catch (const std::runtime_error&) { ++refused; }
+    assert(refused == 3);
+
+    // Erasing with promotion splices the children into the erased node's place
+    tree.erase(two, ErasePolicy::PromoteChildren);
+    std::vector<int> children;
+    for (SummedTree::NodeType* child : thirteen->children) {
+        children.push_back(child->get_value());
+    }
+    assert(children == std::vector<int>({5, 6, 7}));
+    assert(six->parent == thirteen && six->sibling_index == 1);
+    assert(tree.size() == 12);
+    tree.erase(tree.find(tree.getRoot(), 3));  // Takes 8, 9 and 10 with it
+    assert(tree.size() == 8);
+    assert(tree.aggregate() == 1 + 4 + 11 + 12 + 13 + 5 + 6 + 7);
+    assert(tree.getRoot()->children[0]->get_value() == 4);
+
+    // Moves hand over ownership without copying
+    SummedTree moved(std::move(tree));
+    assert(tree.size() == 0);
+    assert(moved.size() == 8);
+    tree = std::move(moved);
+    assert(tree.size() == 8 && moved.size() == 0);
+
+    // A compressed tree shares nodes, so node-pointer mutations refuse it instead of expanding under the caller
+    SummedTree shared;
+    build_bfs_tree(shared, 13);
+    shared.compress();
+    SummedTree::NodeType* child = shared.getRoot()->children[0];
+    bool threw = false;
+    try {
+        shared.detach(child);
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    assert(threw && shared.size() == 13);
+    threw = false;
+    try {
+        shared.erase(child);
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    assert(threw && shared.size() == 13);
+    shared.expand();
+    SummedTree part = shared.detach(shared.getRoot()->children[0]);
+    assert(part.size() == 4 && shared.size() == 9);
+
+    // Attaching refolds the subtree's aggregates with this tree's combine
+    SummedTree summed;
+    build_bfs_tree(summed, 4);
+    summed.set_aggregate([](const int& a, const int& b) { return a + b; });
+    SummedTree maxed;
+    build_bfs_tree(maxed, 4);
+    maxed.set_aggregate([](const int& a, const int& b) { return std::max(a, b); });
+    summed.attach(summed.find(summed.getRoot(), 4), maxed);
+    assert(summed.aggregate() == 10 + 10);
+    assert(summed.find(summed.getRoot(), 4)->children[0]->aggregate == 10);
+    std::cout << "test_detach_attach_erase passed!" << std::endl;
+}
+
+// Function to test pruned visitor traversals
+void test_visit() {
+    std::cout << "Running test_visit..." << std::endl;
+    Tree<int, 3> tree;
+    build_bfs_tree(tree, 40);
+
+    // Depth limit: only the top two levels are reached
+    std::vector<int> seen;
+    std::vector<size_t> depths;
+    assert(tree.visit([&](Node<int>* node, size_t depth) {
+        seen.push_back(node->get_value());
+        depths.push_back(depth);
+        return VisitResult::Continue;
+    }, nullptr, 1));
+    assert(seen == std::vector<int>({1, 2, 3, 4}));
+    assert(depths == std::vector<size_t>({0, 1, 1, 1}));
+
+    // Skipping a subtree and starting below the root; depth counts from the start node
+    seen.clear();
+    Node<int>* two = tree.find(tree.getRoot(), 2);
+    tree.visit([&](Node<int>* node, size_t depth) {
+        seen.push_back(node->get_value());
+        assert(depth == (node == two ? 0u : node->get_value() <= 7 ? 1u : 2u));
+        return node->get_value() == 5 ? VisitResult::SkipChildren : VisitResult::Continue;
+    }, two);
+    assert(seen == std::vector<int>({2, 5, 6, 17, 18, 19, 7, 20, 21, 22}));
+
+    // Early exit stops without touching the rest of the tree
+    size_t visited = 0;
+    assert(!tree.visit_bfs([&](Node<int>* node, size_t) {
+        ++visited;
+        return node->get_value() == 6 ? VisitResult::Stop : VisitResult::Continue;
+    }));
+    assert(visited == 6);
+
+    seen.clear();
+    tree.visit_bfs([&](Node<int>* node, size_t depth) {
+        seen.push_back(node->get_value());
+        return depth == 1 && node->get_value() != 3 ? VisitResult::SkipChildren : VisitResult::Continue;
+    }, nullptr, 2);
+    assert(seen == std::vector<int>({1, 2, 3, 4, 8, 9, 10}));
+
+    // Depth boundary: every node at depth == max_depth is visited and nothing deeper is reached
+    const size_t reached[] = {1, 4, 13, 40, 40};  // Levels hold 1, 3, 9 and 27 nodes
+    for (size_t max_depth = 0; max_depth <= 4; ++max_depth) {
+        size_t dfs_count = 0, dfs_at_limit = 0, bfs_count = 0, bfs_at_limit = 0;
+        assert(tree.visit([&](Node<int>*, size_t depth) {
+            assert(depth <= max_depth);
+            ++dfs_count;
+            if (depth == max_depth) ++dfs_at_limit;
+            return VisitResult::Continue;
+        }, nullptr, max_depth));
+        assert(tree.visit_bfs([&](Node<int>*, size_t depth) {
+            assert(depth <= max_depth);
+            ++bfs_count;
+            if (depth == max_depth) ++bfs_at_limit;
+            return VisitResult::Continue;
+        }, nullptr, max_depth));
+        assert(dfs_count == reached[max_depth] && bfs_count == reached[max_depth]);
+        size_t level = max_depth < 4 ? reached[max_depth] - (max_depth ? reached[max_depth - 1] : 0) : 0;
+        assert(dfs_at_limit == level && bfs_at_limit == level);
+    }
+    std::cout << "test_visit passed!" << std::endl;
+}
+
+// Collect values through Tree::for_each in the given order
+template <Order O, typename T, int K>
+std::vector<int> for_each_values(Tree<T, K>& tree) {
+    std::vector<int> values;
+    tree.template for_each<O>([&values](Node<int>* node) { values.push_back(node->get_value()); });
+    return values;
+}
+
+// Function to test internal iteration with compile-time order dispatch
+void test_for_each() {
+    std::cout << "Running test_for_each..." << std::endl;
+    Tree<int, 2> binary;
+    build_bfs_tree(binary, 12);
+    assert(for_each_values<Order::Pre>(binary) == collect_values(binary.begin_pre_order(), binary.end_pre_order()));
+    assert(for_each_values<Order::Post>(binary) == collect_values(binary.begin_post_order(), binary.end_post_order()));
+    assert(for_each_values<Order::In>(binary) == collect_values(binary.begin_in_order(), binary.end_in_order()));
+    assert(for_each_values<Order::Level>(binary) == collect_values(binary.begin_bfs_scan(), binary.end_bfs_scan()));
+
+    Tree<int, 3> ternary;
+    build_bfs_tree(ternary, 40);
+    assert(for_each_values<Order::Pre>(ternary) == collect_values(ternary.begin_dfs_scan(), ternary.end_dfs_scan()));
+    assert(for_each_values<Order::Post>(ternary) == collect_values(ternary.begin_post_order(), ternary.end_post_order()));
+    assert(for_each_values<Order::Level>(ternary) == collect_values(ternary.begin_bfs_scan(), ternary.end_bfs_scan()));
+
+    Tree<int, 3> single;
+    Node<int> only(7);
+    single.add_root(only);
+    assert(for_each_values<Order::Pre>(single) == std::vector<int>({7}));
+    assert(for_each_values<Order::Post>(single) == std::vector<int>({7}));
+    Tree<int, 3> empty;
+    assert(for_each_values<Order::Pre>(empty).empty());
+
+    // No order reads parent links, so they all walk the compressed form, shared subtrees included
+    Tree<int> levels;
+    Node<int> level_root(0);
+    levels.add_root(level_root);
+    grow_levels(levels.getRoot(), 0, 4);
+    std::vector<int> pre = for_each_values<Order::Pre>(levels);
+    std::vector<int> post = for_each_values<Order::Post>(levels);
+    std::vector<int> in = for_each_values<Order::In>(levels);
+    std::vector<int> level = for_each_values<Order::Level>(levels);
+    levels.compress();
+    assert(levels.node_count() == 5);
+    assert(for_each_values<Order::Pre>(levels) == pre);
+    assert(for_each_values<Order::Post>(levels) == post);
+    assert(for_each_values<Order::In>(levels) == in);
+    assert(for_each_values<Order::Level>(levels) == level);
+    assert(pre.size() == 31);
+    std::cout << "test_for_each passed!" << std::endl;
+}
+
+// Function to test memoised traversal sequences
+void test_sequence_cache() {
+    std::cout << "Running test_sequence_cache..." << std::endl;
+    Tree<int, 2> tree;
+    build_bfs_tree(tree, 15);
+    const std::vector<Node<int>*>& pre = tree.sequence(Order::Pre);
+    assert(collect_values(pre.begin(), pre.end()) == collect_values(tree.begin_pre_order(), tree.end_pre_order()));
+    const std::vector<Node<int>*>& in = tree.sequence(Order::In);
+    assert(collect_values(in.begin(), in.end()) == collect_values(tree.begin_in_order(), tree.end_in_order()));
+
+    // Repeat calls reuse the same array until the structure changes
+    const Node<int>* const* data = pre.data();
+    tree.sequence(Order::Pre);
+    assert(tree.sequence(Order::Pre).data() == data);
+    tree.getRoot()->get_value() = 1;  // Values may change without invalidating anything
+    assert(tree.sequence(Order::Pre).data() == data);
+
+    Node<int> parent(8);
+    Node<int> child(16);
+    tree.add_sub_node(parent, child);
+    const std::vector<Node<int>*>& level = tree.sequence(Order::Level);
+    assert(level.size() == 16);
+    assert(level.back()->get_value() == 16);
+    assert(tree.sequence(Order::Pre).size() == 16);
+
+    tree.myHeap();
+    const std::vector<Node<int>*>& post = tree.sequence(Order::Post);
+    assert(collect_values(post.begin(), post.end()) == collect_values(tree.begin_post_order(), tree.end_post_order()));
+
+    tree.compress();
+    assert(tree.sequence(Order::Post).size() == 16);
+    tree.clear();
+    assert(tree.sequence(Order::Pre).empty());
+    std::cout << "test_sequence_cache passed!" << std::endl;
+}
+
+// Value whose copies start throwing once a budget runs out (negative budget: never)
+struct Fragile {
+    int value;
+    static int copies_left;
+
+    explicit Fragile(int value) : value(value) {}
+
+    Fragile(const Fragile& other) : value(other.value) {
+        if (copies_left == 0) throw std::runtime_error("copy failed");
+        if (copies_left > 0) --copies_left;
+    }
+
+    Fragile& operator=(const Fragile&) = default;
+
+    bool operator==(const Fragile& other) const { return value == other.value; }
+};
+
+int Fragile::copies_left = -1;
+
+namespace std {
+template <>
+struct hash<Fragile> {
+    size_t operator()(const Fragile& f) const { return hash<int>()(f.value); }
+};
+}
+
+// Function to test relocating nodes into traversal order
+void test_compact() {
+    std::cout << "Running test_compact..." << std::endl;
+    typedef Tree<int, 3, NoInstrumentation, AggregateSummary<int>> SummedTree;
+    SummedTree tree;
+    build_bfs_tree(tree, 200);
+    tree.set_aggregate([](const int& a, const int& b) { return a + b; });
+    std::vector<int> dfs = collect_values(tree.begin_dfs_scan(), tree.end_dfs_scan());
+    size_t hash = tree.structural_hash();
+
+    tree.compact(Order::Level);
+    const std::vector<SummedTree::NodeType*>& level = tree.sequence(Order::Level);
+    for (size_t i = 1; i < level.size(); ++i) {
+        assert(level[i] == level[0] + i);  // One block, in BFS order
+    }
+    assert(tree.structural_hash() == hash);
+    assert(tree.aggregate() == 200 * 201 / 2);
+    assert(collect_values(tree.begin_dfs_scan(), tree.end_dfs_scan()) == dfs);
+    assert(collect_values(tree.begin_stackless_dfs_scan(), tree.end_stackless_dfs_scan()) == dfs);
+
+    tree.compact(Order::Pre);
+    const std::vector<SummedTree::NodeType*>& pre = tree.sequence(Order::Pre);
+    for (size_t i = 1; i < pre.size(); ++i) {
+        assert(pre[i] == pre[0] + i);
+    }
+    assert(tree.getRoot() == pre[0]);
+    assert(tree.lca(tree.find(tree.getRoot(), 20), tree.find(tree.getRoot(), 21)) == tree.find(tree.getRoot(), 7));
+
+    // Block-owned nodes can be mixed with new ones, erased, detached and outlive the tree they came from
+    SummedTree::NodeType parent(200);
+    SummedTree::NodeType child(201);
+    tree.add_sub_node(parent, child);
+    tree.erase(tree.find(tree.getRoot(), 3));
+    SummedTree branch = tree.detach(tree.find(tree.getRoot(), 2));
+    tree.clear();
+    assert(branch.size() == 1 + 3 + 9 + 27 + 79 + 1);  // Nodes 122..200, plus 201 under 200
+    branch.compress();
+    branch.expand();
+    branch.compact(Order::Post);
+    assert(branch.sequence(Order::Post).back() == branch.getRoot());
+    assert(branch.size() == 120);
+
+    // Detaching and re-attaching a child must not grow the shared block list
+    for (int cycle = 0; cycle < 40; ++cycle) {
+        SummedTree::NodeType* first = branch.getRoot()->children[0];
+        SummedTree piece = branch.detach(first);
+        branch.attach(branch.getRoot(), piece);
+    }
+    assert(branch.block_count() == 1);
+    assert(branch.size() == 120);
+
+    // Pieces of several compacted trees keep every block, and clear() still frees each node the right way
+    SummedTree merged;
+    SummedTree::NodeType merged_root(0);
+    merged.add_root(merged_root);
+    SummedTree::NodeType* at = merged.getRoot();
+    for (int part = 0; part < 8; ++part) {
+        SummedTree donor;
+        build_bfs_tree(donor, 13);
+        donor.compact();
+        SummedTree::NodeType* donor_root = donor.getRoot();
+        merged.attach(at, donor);
+        at = merged.find(donor_root, 5);  // A leaf, so the next piece has room
+    }
+    assert(merged.block_count() == 8);
+    merged.add_sub_node(at, 300);  // One node outside every block
+    assert(merged.size() == 1 + 8 * 13 + 1);
+    merged.erase(merged.getRoot()->children[0]->children[1]);
+    merged.clear();
+    assert(merged.size() == 0 && merged.block_count() == 0);
+
+    bool thrown = false;
+    try {
+        branch.compact(Order::In);
+    } catch (const std::runtime_error&) {
+        thrown = true;
+    }
+    assert(thrown);
+
+    // A throwing copy leaves the tree as it was
+    Tree<Fragile, 3> fragile;
+    Node<Fragile> fragile_root(Fragile(1));
+    fragile.add_root(fragile_root);
+    for (int i = 2; i <= 20; ++i) {
+        Node<Fragile> parent(Fragile((i - 2) / 3 + 1));
+        Node<Fragile> child((Fragile(i)));
+        fragile.add_sub_node(parent, child);
+    }
+    Fragile::copies_left = 25;
+    thrown = false;
+    try {
+        fragile.compact();
+    } catch (const std::runtime_error&) {
+        thrown = true;
+    }
+    Fragile::copies_left = -1;
+    assert(thrown);
+    assert(fragile.size() == 20 && fragile.block_count() == 0);
+    int expected = 1;
+    for (auto it = fragile.begin_bfs_scan(); it != fragile.end_bfs_scan(); ++it) {
+        assert(it->get_value().value == expected++);
+    }
+    std::cout << "test_compact passed!" << std::endl;
+}
+
+// Function to test best-first and beam traversal
+void test_best_first() {
+    std::cout << "Running test_best_first..." << std::endl;
+    Tree<int, 3> tree;
+    build_bfs_tree(tree, 121);
+    auto larger = [](const Node<int>* node) { return node->get_value(); };
+
+    // Always the best open node: the rightmost path comes first, and nothing else is opened
+    std::vector<int> order;
+    auto it = tree.begin_best_first(larger);
+    for (int step = 0; step < 5 && it != tree.end_best_first(); ++step, ++it) {
+        order.push_back(it->get_value());
+    }
+    assert(order == std::vector<int>({1, 4, 13, 40, 121}));
+    assert(it.frontier_size() == 2 + 2 + 2 + 2);  // Only the unchosen siblings wait
+
+    // A full run visits every node exactly once
+    size_t count = 0;
+    for (auto all = tree.begin_best_first(larger); all != tree.end_best_first(); ++all) {
+        ++count;
+    }
+    assert(count == 121);
+
+    // With a beam of one, only the single best child survives at each step
+    order.clear();
+    auto smaller = [](const Node<int>* node) { return -node->get_value(); };
+    for (auto beam = tree.begin_best_first(smaller, 1); beam != tree.end_best_first(); ++beam) {
+        assert(beam.frontier_size() <= 1);
+        order.push_back(beam->get_value());
+    }
+    assert(order == std::vector<int>({1, 2, 5, 14, 41}));
+
+    Tree<int, 3> empty;
+    assert(!(empty.begin_best_first(larger) != empty.end_best_first()));
+    std::cout << "test_best_first passed!" << std::endl;
+}
+
+// Function to test many small trees sharing one forest arena
+void test_forest() {
+    std::cout << "Running test_forest..." << std::endl;
+    Forest<int, 3> forest;
+    const int trees = 1000;
+    for (int t = 0; t < trees; ++t) {
+        Forest<int, 3>::Handle root = forest.add_tree(t);
+        Forest<int, 3>::Handle left = forest.add_sub_node(root, 1);
+        forest.add_sub_node(root, 2);
+        forest.add_sub_node(left, 3);
+    }
+    assert(forest.tree_count() == trees);
+    assert(forest.size() == 4 * trees);
+
+    // Batch pass over every node of every tree
+    long long sum = 0;
+    forest.for_each([&sum](int value) { sum += value; });
+    assert(sum == (long long)trees * (trees - 1) / 2 + 6LL * trees);
+
+    // Per-tree pre-order, with trees interleaved in the arena
+    Forest<int, 3>::Handle root = forest.roots()[7];
+    std::vector<int> order;
+    for (auto it = forest.begin_pre_order(root); it != forest.end_pre_order(); ++it) {
+        order.push_back(forest.value(*it));
+    }
+    assert(order == std::vector<int>({7, 1, 3, 2}));
+    assert(forest.child_count(root) == 2);
+    assert(forest.parent(forest.first_child(root)) == root);
+
+    bool threw = false;
+    forest.add_sub_node(root, 4);
+    try {
+        forest.add_sub_node(root, 5);
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    assert(threw);
+
+    // Round trip through a pointer-based tree
+    Tree<int, 3> tree;
+    build_bfs_tree(tree, 40);
+    Forest<int, 3>::Handle copy = tree.copy_to(forest);
+    Tree<int, 3> restored;
+    restored.restore(forest, copy);
+    assert(restored == tree);
+    std::vector<int> expected, actual, round_trip;
+    for (auto it = tree.begin_pre_order(); it != tree.end_pre_order(); ++it) expected.push_back((*it)->get_value());
+    for (auto it = forest.begin_pre_order(copy); it != forest.end_pre_order(); ++it) actual.push_back(forest.value(*it));
+    for (auto it = restored.begin_pre_order(); it != restored.end_pre_order(); ++it) round_trip.push_back((*it)->get_value());
+    assert(actual == expected && round_trip == expected);
+
+    forest.clear();
+    assert(forest.empty() && forest.size() == 0);
+    std::cout << "test_forest passed!" << std::endl;
+}
+
+// Function to test the instrumentation policy counters and memory accounting
+void test_instrumentation() {
+    std::cout << "Running test_instrumentation..." << std::endl;
+    // Disabled by default: iterators carry no hook state
+    assert(sizeof(Tree<int, 3>::PreOrderIterator) == sizeof(std::stack<Node<int>*>));
+    assert(sizeof(Tree<int, 3>::StacklessPreOrderIterator) == 2 * sizeof(Node<int>*));
+
+    Tree<int, 3, CountingInstrumentation> tree;
+    build_bfs_tree(tree, 13);
+    const CountingInstrumentation& counters = tree.instrumentation();
+    assert(counters.allocations == 13);
+    assert(counters.releases == 0);
+
+    tree.instrumentation().reset();
+    for (auto it = tree.begin_pre_order(); it != tree.end_pre_order(); ++it) {
+    }
+    assert(counters.nodes_visited == 13);
+    assert(counters.peak_frontier == 5);  // Two siblings of node 2 plus its three children
+
+    tree.instrumentation().reset();
+    for (auto it = tree.begin_bfs_scan(); it != tree.end_bfs_scan(); ++it) {
+    }
+    assert(counters.nodes_visited == 13);
+    assert(counters.peak_frontier == 9);  // All of the last level
+
+    tree.instrumentation().reset();
+    assert(tree.find(tree.getRoot(), 1) && counters.find_probes == 1);
+    assert(tree.find(tree.getRoot(), 13) && counters.find_probes == 1 + 13);
+    tree.for_each<Order::Level>([](Node<int>*) {});
+    assert(counters.nodes_visited == 13);
+
+    TreeMemoryUsage usage = tree.memory_usage();
+    assert(usage.nodes == 13);
+    assert(usage.node_bytes == 13 * sizeof(Node<int>));
+    assert(usage.child_vector_bytes >= 12 * sizeof(Node<int>*));
+    assert(usage.total_bytes() == usage.node_bytes + usage.child_vector_bytes + usage.cache_bytes);
+
+    tree.clear();
+    assert(counters.releases == 13);
+    assert(tree.memory_usage().nodes == 0);
+    std::cout << "test_instrumentation passed!" << std::endl;
+}
+
+// Function to test that deep chains do not exhaust the call stack
+void test_deep_chain() {
+    std::cout << "Running test_deep_chain..." << std::endl;
+    const int depth = 1000000;
+    Forest<int, 1> forest;
+    Forest<int, 1>::Handle last = forest.add_tree(1);
+    for (int i = 2; i <= depth; ++i) {
+        last = forest.add_sub_node(last, i);
+    }
+    Tree<int, 1> chain;
+    chain.restore(forest, forest.roots()[0]);
+    assert(chain.size() == size_t(depth) && chain.height() == size_t(depth));
+
+    Tree<int, 1>::NodeType* tail = chain.find(chain.getRoot(), depth);
+    assert(tail && tail->children.empty());
+    assert(chain.find(chain.getRoot(), depth + 1) == nullptr);
+    Tree<int, 1>::NodeType* extra = chain.add_sub_node(tail, depth + 1);  // No search for the parent
+    assert(extra->parent == tail && chain.size() == size_t(depth) + 1);
+    chain.erase(extra);
+
+    Tree<int, 1> copy;
+    copy.restore(forest, forest.roots()[0]);
+    assert(chain == copy);
+    copy.find(copy.getRoot(), depth)->value = 0;
+    copy.refresh();
+    std::vector<NodeDiff<int>> changes = diff(chain, copy);
+    assert(changes.size() == 1 && changes[0].after->value == 0);
+
+    chain.compress();
+    chain.expand();
+    assert(chain.size() == size_t(depth));
+    chain.myHeap();
+    assert(chain.getRoot()->value == 1);
+    chain.clear();
+    assert(chain.size() == 0);
+    std::cout << "test_deep_chain passed!" << std::endl;
+}
+
+// Helper: sum of the values in a subtree, written once for any pointer-like node type
+template <typename NodePtr>
+long long subtree_sum(NodePtr node) {
+    long long sum = 0;
+    std::vector<NodePtr> stack(1, node);
+    while (!stack.empty()) {
+        NodePtr current = stack.back();
+        stack.pop_back();
+        sum += current->value;
+        for (auto child : current->children) {
+            stack.push_back(child);
+        }
+    }
+    return sum;
+}
+
+// Function to test the out-of-core paged tree
+void test_paged_tree() {
+    std::cout << "Running test_paged_tree..." << std::endl;
+    Tree<int, 3> tree;
+    build_bfs_tree(tree, 100);
+    tree.save_paged("test_tree.kpag", 8);
+
+    {
+        PagedTree<int, 3> paged("test_tree.kpag", 2 * 8 * sizeof(PagedRecord<int>));
+        assert(paged.size() == 100);
+        assert(paged.page_count() == 13);
+        assert(paged.value(0) == 1);
+        size_t none = PagedTree<int, 3>::none;
+        assert(paged.parent(0) == none);
+        assert(paged.child_count(0) == 3);
+        size_t third = paged.child(0, 2);
+        assert(paged.value(third) == 4);
+        assert(paged.parent(third) == 0);
+
+        // The traversals match the in-memory ones while at most two pages are resident; the same helpers
+        // read both, since the iterators yield node-like views
+        assert(collect_values(paged.begin_bfs_scan(), paged.end_bfs_scan()) ==
+               collect_values(tree.begin_bfs_scan(), tree.end_bfs_scan()));
+        for (auto it = paged.begin_dfs_scan(); it != paged.end_dfs_scan(); ++it) {
+            assert(paged.resident_pages() <= 2);
+        }
+        assert(collect_values(paged.begin_dfs_scan(), paged.end_dfs_scan()) ==
+               collect_values(tree.begin_dfs_scan(), tree.end_dfs_scan()));
+        assert(collect_values(paged.begin_pre_order(), paged.end_pre_order()) ==
+               collect_values(tree.begin_pre_order(), tree.end_pre_order()));
+
+        // Visitor code written against node->value and node->children runs on both trees
+        assert(subtree_sum(paged.root()) == subtree_sum(tree.getRoot()));
+        assert(subtree_sum(paged.root()->children[2]) == subtree_sum(tree.getRoot()->children[2]));
+        auto it = paged.begin_bfs_scan();
+        ++it;
+        assert((*it)->get_value() == 2 && (*it).index() == 1 && (*it)->children.size() == 3);
+        assert(paged.cache_misses() >= paged.page_count());
+        assert(paged.cache_hits() > 0);
+
+        paged.set_memory_budget(0);  // Still keeps one page
+        assert(paged.resident_pages() == 1);
+        assert(paged.value(99) == 100);
+    }
+
+    bool thrown = false;
+    try {
+        PagedTree<int, 2> narrow("test_tree.kpag");  // Three children do not fit a binary tree
+    } catch (const std::runtime_error&) {
+        thrown = true;
+    }
+    assert(thrown);
+    thrown = false;
+    try {
+        PagedTree<float, 3> floats("test_tree.kpag");  // Same size, different kind of value
+    } catch (const std::runtime_error&) {
+        thrown = true;
+    }
+    assert(thrown);
+
+    // Streaming the same tree in BFS order builds it without an in-memory Tree
+    {
+        PagedTreeWriter<int, 3> writer("test_stream.kpag", 8);
+        writer.add_root(1);
+        for (int i = 2; i <= 100; ++i) {
+            writer.add_child(static_cast<size_t>((i - 2) / 3), i);
+        }
+        thrown = false;
+        try {
+            writer.add_child(0, 101);  // Node 0's children are done
+        } catch (const std::runtime_error&) {
+            thrown = true;
+        }
+        assert(thrown);
+        writer.finish();
+    }
+    {
+        PagedTree<int, 3> saved("test_tree.kpag");
+        PagedTree<int, 3> streamed("test_stream.kpag");
+        assert(streamed.size() == 100 && streamed.page_count() == saved.page_count());
+        for (size_t i = 0; i < streamed.size(); ++i) {
+            assert(streamed.value(i) == saved.value(i));
+            assert(streamed.parent(i) == saved.parent(i));
+            assert(streamed.child_count(i) == saved.child_count(i));
+            for (size_t k = 0; k < streamed.child_count(i); ++k) {
+                assert(streamed.child(i, k) == saved.child(i, k));
+            }
+        }
+    }
+    {
+        PagedTreeWriter<int, 3> unfinished("test_stream.kpag", 8);
+        unfinished.add_root(1);
+    }
+    thrown = false;
+    try {
+        PagedTree<int, 3> partial("test_stream.kpag");  // No header without finish()
+    } catch (const std::runtime_error&) {
+        thrown = true;
+    }
+    assert(thrown);
+    std::remove("test_stream.kpag");
+    std::remove("test_tree.kpag");
+    std::cout << "test_paged_tree passed!" << std::endl;
+}
+
+// Function to test the succinct LOUDS encoding
+void test_succinct_tree() {
+    std::cout << "Running test_succinct_tree..." << std::endl;
+    Tree<int, 3> tree;
+    build_bfs_tree(tree, 5000);
+    SuccinctTree<int> succinct = tree.succinct();
+    assert(succinct.size() == 5000);
+    assert(succinct.structure_bytes() < 5000 * sizeof(Node<int>*));
+
+    // Every node agrees with its pointer-based original
+    std::vector<Node<int>*> nodes;
+    for (auto it = tree.begin_bfs_scan(); it != tree.end_bfs_scan(); ++it) {
+        nodes.push_back(*it);
+    }
+    std::unordered_map<Node<int>*, size_t> ids;
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        ids[nodes[i]] = i;
+    }
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        assert(succinct.value(i) == nodes[i]->get_value());
+        assert(succinct.degree(i) == nodes[i]->children.size());
+        for (size_t k = 0; k < nodes[i]->children.size(); ++k) {
+            assert(succinct.child(i, k) == ids[nodes[i]->children[k]]);
+            assert(succinct.parent(succinct.child(i, k)) == i);
+        }
+        assert(succinct.subtree_size(i) == nodes[i]->size);
+    }
+    size_t none = SuccinctTree<int>::none;
+    assert(succinct.parent(0) == none);
+
+    std::vector<int> bfs;
+    for (auto it = succinct.begin_bfs_scan(); it != succinct.end_bfs_scan(); ++it) {
+        bfs.push_back(*it);
+    }
+    assert(bfs == collect_values(tree.begin_bfs_scan(), tree.end_bfs_scan()));
+    std::vector<int> dfs;
+    for (auto it = succinct.begin_dfs_scan(); it != succinct.end_dfs_scan(); ++it) {
+        dfs.push_back(*it);
+    }
+    assert(dfs == collect_values(tree.begin_dfs_scan(), tree.end_dfs_scan()));
+
+    Tree<std::string> empty;
+    SuccinctTree<std::string> nothing = empty.succinct();
+    assert(nothing.size() == 0);
+    assert(!(nothing.begin_dfs_scan() != nothing.end_dfs_scan()));
+    std::cout << "test_succinct_tree passed!" << std::endl;
+}
+
+// Function to test persistent versions with structural sharing
+void test_persistent_tree() {
+    std::cout << "Running test_persistent_tree..." << std::endl;
+    Tree<int, 3> tree;
+    build_bfs_tree(tree, 13);
+    PersistentTree<int, 3> v1 = tree.persistent();
+    assert(v1.size() == 13);
+
+    // Updating a snapshot copies only the root-to-change path
+    PersistentTree<int, 3> v2 = v1.snapshot();
+    assert(v2.root() == v1.root());
+    v2.add_sub_node({2, 0}, 14);  // Under node 11
+    assert(v2.size() == 14);
+    assert(v1.size() == 13);
+    assert(v2.root() != v1.root());
+    assert(v2.root()->children[0] == v1.root()->children[0]);
+    assert(v2.root()->children[1] == v1.root()->children[1]);
+    assert(v2.root()->children[2] != v1.root()->children[2]);
+    assert(v2.root()->children[2]->children[1] == v1.root()->children[2]->children[1]);
+    assert(v2.find({2, 0, 0})->value == 14);
+    assert(v1.find({2, 0, 0}) == nullptr);
+
+    PersistentTree<int, 3> v3 = v2.snapshot();
+    v3.set_value({0}, 20);
+    v3.remove({1});
+    assert(v3.size() == 10);
+    assert(v3.find({0})->value == 20);
+    assert(v3.find({1})->value == 4);
+    assert(v2.find({0})->value == 2);
+
+    std::vector<int> dfs;
+    for (auto it = v3.begin_dfs_scan(); it != v3.end_dfs_scan(); ++it) {
+        dfs.push_back(it->value);
+    }
+    assert(dfs == std::vector<int>({1, 20, 5, 6, 7, 4, 11, 14, 12, 13}));
+
+    bool thrown = false;
+    try {
+        v3.add_sub_node({}, 99);
+        v3.add_sub_node({}, 99);  // The root already has three children now
+    } catch (const std::runtime_error&) {
+        thrown = true;
+    }
+    assert(thrown);
+
+    // Shared nodes live as long as any version still uses them
+    std::weak_ptr<const PersistentNode<int>> leaf = v1.root()->children[0]->children[0];
+    v1 = PersistentTree<int, 3>();
+    assert(!leaf.expired());
+    v2 = PersistentTree<int, 3>();
+    v3 = PersistentTree<int, 3>();
+    assert(leaf.expired());
+
+    // Rolling the tree back to a snapshot
+    PersistentTree<int, 3> before = tree.persistent();
+    Node<int> extra(42);
+    Node<int> parent(13);
+    tree.add_sub_node(parent, extra);
+    tree.restore(before);
+    Tree<int, 3> expected;
+    build_bfs_tree(expected, 13);
+    assert(tree == expected);
+
+    // Copying a deep chain and dropping its last version do not recurse once per level
+    const size_t depth = 1000000;
+    Node<int>* chain = new Node<int>(0);
+    Node<int>* tail = chain;
+    for (size_t i = 1; i < depth; ++i) {
+        tail->add_child(new Node<int>(static_cast<int>(i)));
+        tail = tail->children[0];
+    }
+    {
+        PersistentTree<int, 1> deep(chain);
+        assert(deep.size() == depth);
+        PersistentTree<int, 1> edited = deep.snapshot();
+        edited.set_value(PersistentTree<int, 1>::Path(depth - 1, 0), -1);  // Copies the whole path
+        assert(edited.size() == depth && deep.size() == depth);
+    }
+    while (chain) {
+        Node<int>* next = chain->children.empty() ? nullptr : chain->children[0];
+        delete chain;
+        chain = next;
+    }
+    std::cout << "test_persistent_tree passed!" << std::endl;
+}
+
+// Function to test lock-free readers against a concurrent writer
+void test_concurrent_tree() {
+    std::cout << "Running test_concurrent_tree..." << std::endl;
+    typedef ConcurrentTree<int, 3> Concurrent;
+    Concurrent tree;
+    std::atomic<bool> done(false);
+    std::atomic<size_t> bad(0);
+    std::vector<std::thread> readers;
+    for (int r = 0; r < 4; ++r) {
+        readers.push_back(std::thread([&] {
+            while (!done.load()) {
+                // Every child a reader sees was published whole; values grow downwards in every version
+                for (auto it = tree.begin_dfs_scan(); it != tree.end_dfs_scan(); ++it) {
+                    it->for_each_child([&](const Concurrent::NodeType* child) {
+                        if (child->value <= it->value) ++bad;
+                    });
+                }
+                size_t seen = 0;
+                for (auto it = tree.begin_bfs_scan(); it != tree.end_bfs_scan(); ++it) {
+                    ++seen;
+                }
+                if (seen > 3000) ++bad;
+            }
+        }));
+    }
+
+    std::vector<Concurrent::NodeType*> nodes;
+    nodes.push_back(tree.add_root(1));
+    for (int i = 2; i <= 3000; ++i) {
+        nodes.push_back(tree.add_sub_node(nodes[(i - 2) / 3], i));
+    }
+    assert(tree.size() == 3000);
+    // Readers may still be inside the removed subtrees
+    tree.remove(nodes[1], 0);  // Node 5 and below
+    tree.remove(nodes[0], 1);  // Node 3 and below
+    assert(tree.find(5) == nullptr);
+    assert(tree.find(3) == nullptr);
+    assert(tree.find(6)->value == 6);
+    tree.add_root(1);
+    tree.myHeap();
+    done.store(true);
+    for (std::thread& reader : readers) {
+        reader.join();
+    }
+    assert(bad.load() == 0);
+
+    size_t seen = 0;
+    int previous = 0;
+    for (auto it = tree.begin_bfs_scan(); it != tree.end_bfs_scan(); ++it) {
+        ++seen;
+        if (seen == 1) previous = it->value;
+    }
+    assert(seen == tree.size());
+    assert(previous == 1);  // The heap keeps the smallest value at the root
+
+    // Nothing is freed while a reader is pinned, and everything once it leaves
+    {
+        EpochReclaimer::Guard guard = tree.read();
+        const Concurrent::NodeType* root = tree.getRoot();
+        tree.clear();
+        assert(tree.pending_reclamation() > 0);
+        assert(root->value == 1);
+    }
+    tree.collect();
+    assert(tree.pending_reclamation() == 0);
+    assert(tree.size() == 0);
+
+    // Readers that pin and then load the root never see a root freed by a writer replacing it
+    tree.add_root(1);
+    done.store(false);
+    readers.clear();
+    for (int r = 0; r < 4; ++r) {
+        readers.push_back(std::thread([&] {
+            while (!done.load()) {
+                EpochReclaimer::Guard guard = tree.read();
+                if (tree.getRoot()->value < 1) ++bad;
+            }
+        }));
+    }
+    for (int i = 2; i <= 20000; ++i) {
+        tree.add_root(i);  // Retires the previous root and collects
+    }
+    done.store(true);
+    for (std::thread& reader : readers) {
+        reader.join();
+    }
+    assert(bad.load() == 0);
+
+    // A guard beyond the slot table throws instead of waiting forever
+    std::vector<EpochReclaimer::Guard> guards;
+    for (size_t i = 0; i < EpochReclaimer::max_readers; ++i) {
+        guards.push_back(tree.read());
+    }
+    bool refused = false;
+    try {
+        EpochReclaimer::Guard extra = tree.read();
+    } catch (const std::runtime_error&) {
+        refused = true;
+    }
+    assert(refused);
+    guards.pop_back();
+    EpochReclaimer::Guard freed_slot = tree.read();
+    std::cout << "test_concurrent_tree passed!" << std::endl;
+}
+
+// Function to test parallel construction through per-thread builders
+void test_concurrent_builders() {
+    std::cout << "Running test_concurrent_builders..." << std::endl;
+    typedef ConcurrentTree<int, 4> Concurrent;
+    Concurrent tree;
+    std::vector<Concurrent::NodeType*> parents;
+    Concurrent::NodeType* root = tree.add_root(0);
+    for (int i = 0; i < 4; ++i) {
+        Concurrent::NodeType* child = tree.add_sub_node(root, 1);
+        for (int j = 0; j < 4; ++j) {
+            parents.push_back(tree.add_sub_node(child, 2));
+        }
+    }
+
+    std::atomic<bool> done(false);
+    std::atomic<size_t> bad(0);
+    std::thread reader([&] {
+        while (!done.load()) {
+            for (auto it = tree.begin_dfs_scan(); it != tree.end_dfs_scan(); ++it) {
+                if (it->child_count() > 4) ++bad;
+                it->for_each_child([&](const Concurrent::NodeType* child) {
+                    if (child->value != it->value + 1) ++bad;
+                });
+            }
+        }
+    });
+
+    // Eight threads race for the 64 free slots, then grow their own subtrees
+    std::atomic<size_t> won(0), refused(0);
+    std::vector<std::thread> builders;
+    for (int t = 0; t < 8; ++t) {
+        builders.push_back(std::thread([&] {
+            Concurrent::Builder builder = tree.builder();
+            std::vector<Concurrent::NodeType*> mine;
+            for (Concurrent::NodeType* parent : parents) {
+                try {
+                    mine.push_back(builder.add_sub_node(parent, 3));
+                    ++won;
+                } catch (const std::runtime_error&) {
+                    ++refused;
+                }
+            }
+            for (Concurrent::NodeType* node : mine) {
+                for (int c = 0; c < 4; ++c) {
+                    builder.add_sub_node(node, 4);
+                }
+            }
+        }));
+    }
+    for (std::thread& builder : builders) {
+        builder.join();
+    }
+    done.store(true);
+    reader.join();
+
+    assert(bad.load() == 0);
+    assert(won.load() == 64);
+    assert(refused.load() == 64);
+    assert(tree.size() == 1 + 4 + 16 + 64 + 64 * 4);
+    size_t seen = 0;
+    for (auto it = tree.begin_bfs_scan(); it != tree.end_bfs_scan(); ++it) {
+        assert(it->child_count() == (it->value < 4 ? 4u : 0u));
+        ++seen;
+    }
+    assert(seen == tree.size());
+
+    // Arena nodes are reclaimed like any other once unlinked
+    tree.remove(parents[0], 0);
+    assert(tree.size() == 1 + 4 + 16 + 63 + 63 * 4);
+    tree.clear();
+    tree.collect();
+    assert(tree.size() == 0);
+    assert(tree.pending_reclamation() == 0);
+    std::cout << "test_concurrent_builders passed!" << std::endl;
+}
+
 #ifdef RUN_TESTS
 // Main function to run all tests
 int main() {
@@ -553,6 +2242,31 @@ int main() {
     test_heap_one_child();
     test_complex_equality();
     test_complex_to_string();
+    test_compress_expand();
+    test_merkle_diff();
+    test_subtree_summaries();
+    test_lca_index();
+    test_stackless_iterators();
+    test_dot_export();
+    test_render_queue();
+    test_layout_svg();
+    test_render_options();
+    test_binary_serialization();
+    test_import();
+    test_detach_attach_erase();
+    test_visit();
+    test_for_each();
+    test_sequence_cache();
+    test_compact();
+    test_best_first();
+    test_forest();
+    test_instrumentation();
+    test_deep_chain();
+    test_paged_tree();
+    test_succinct_tree();
+    test_persistent_tree();
+    test_concurrent_tree();
+    test_concurrent_builders();
     std::cout << "All tests passed!" << std::endl;
     return 0;
 }
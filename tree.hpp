@@ -9,87 +9,660 @@
 #include <vector>
 #include <stdexcept>
 #include <algorithm>
+#include <functional>
+#include <memory>
+#include <set>
+#include <iterator>
+#include <utility>
+#include <type_traits>
+#include <new>
+#include <unordered_map>
 #include <iostream>
 #include "tree_printer.hpp"
+#include "lca_index.hpp"
+#include "tree_io.hpp"
+#include "tree_import.hpp"
+#include "paged_tree.hpp"
+#include "succinct_tree.hpp"
+#include "persistent_tree.hpp"
+#include "forest.hpp"
+#include "instrumentation.hpp"
+#include "summary.hpp"
+
+// What Tree::erase() does with the erased node's children
+enum class ErasePolicy {
+    Subtree,         // Free the children along with the node
+    PromoteChildren  // Move the children up into the node's place in its parent
+};
+
+// What a visitor passed to Tree::visit() / visit_bfs() asks for next
+enum class VisitResult {
+    Continue,      // Go on, including this node's children
+    SkipChildren,  // Go on, but leave out this node's subtree
+    Stop           // End the traversal now
+};
+
+// Traversal orders for Tree::for_each()
+enum class Order {
+    Pre,   // Node, then its children left to right
+    Post,  // Children left to right, then the node
+    In,    // Binary: left subtree, node, right subtree
+    Level  // Breadth-first, level by level
+};
+
+// Template class for k-ary tree; Instrumentation picks the counters it keeps (see instrumentation.hpp),
+// Summary the per-node fields it maintains (see summary.hpp)
+template <typename T, int K = 2, typename Instrumentation = NoInstrumentation, typename Summary = StructuralSummary>
+class Tree : private Instrumentation {
+public:
+    typedef Node<T, Summary> NodeType;
 
-// Template class for k-ary tree
-template <typename T, int K = 2>
-class Tree {
 private:
-    Node<T>* root;  // Root node of the tree
+    NodeType* root;  // Root node of the tree
+    bool compressed;  // True while identical subtrees are shared (see compress())
+    std::vector<NodeType*> shared_nodes;  // Every distinct node while compressed
+    std::function<T(const T&, const T&)> combine;  // Associative combine for AggregateSummary::aggregate (optional)
+    size_t generation;  // Bumped by every structural mutation
+    LcaIndex<T, Summary> lca_index;  // Ancestor/LCA index, rebuilt lazily when stale
+    size_t lca_generation;  // Generation lca_index was built for
+    std::vector<NodeType*> sequences[4];  // Memoised node order per Order value (see sequence())
+    size_t sequence_generations[4];  // Generation each sequence was built for
+
+    // One allocation holding nodes laid out by compact(); shared with trees detached from this one
+    struct NodeBlock {
+        char* memory;
+        size_t count;
+
+        explicit NodeBlock(size_t nodes)
+            : memory(static_cast<char*>(::operator new(nodes * sizeof(NodeType)))), count(nodes) {}
+
+        ~NodeBlock() {
+            ::operator delete(memory);
+        }
+
+        NodeType* nodes() const {
+            return reinterpret_cast<NodeType*>(memory);
+        }
+
+        bool contains(const NodeType* node) const {
+            return node >= nodes() && node < nodes() + count;
+        }
+    };
+    std::vector<std::shared_ptr<NodeBlock>> blocks;  // Blocks that may hold nodes of this tree, sorted by address
 
 public:
     // Constructor
-    Tree() : root(nullptr) {}
+    Tree() : root(nullptr), compressed(false), generation(0), lca_index(), lca_generation(size_t(-1)) {
+        std::fill(sequence_generations, sequence_generations + 4, size_t(-1));
+    }
 
     // Destructor
     ~Tree() {
         clear();
     }
 
+    // Trees own their nodes, so they move but do not copy
+    Tree(const Tree&) = delete;
+    Tree& operator=(const Tree&) = delete;
+
+    // Move constructor: takes over the other tree's nodes in O(1)
+    Tree(Tree&& other)
+        : root(other.root), compressed(other.compressed), shared_nodes(std::move(other.shared_nodes)),
+          combine(other.combine), generation(other.generation + 1), lca_index(), lca_generation(size_t(-1)),
+          blocks(std::move(other.blocks)) {
+        std::fill(sequence_generations, sequence_generations + 4, size_t(-1));
+        other.root = nullptr;
+        other.compressed = false;
+        other.shared_nodes.clear();
+        other.blocks.clear();
+        ++other.generation;
+    }
+
+    // Move assignment: frees this tree's nodes, then takes over the other's
+    Tree& operator=(Tree&& other) {
+        if (this != &other) {
+            clear();
+            root = other.root;
+            compressed = other.compressed;
+            shared_nodes = std::move(other.shared_nodes);
+            combine = other.combine;
+            blocks = std::move(other.blocks);
+            other.root = nullptr;
+            other.compressed = false;
+            other.shared_nodes.clear();
+            other.blocks.clear();
+            ++other.generation;
+        }
+        return *this;
+    }
+
     // Add root node
-    void add_root(Node<T>& node) {
+    void add_root(NodeType& node) {
         if (!root) {
-            root = new Node<T>(node.value);
+            root = new NodeType(node.value);
+            this->on_allocate(1);
         } else {
             root->value = node.value;
         }
+        refreshNode(root);
+        ++generation;
     }
 
     // Add a child node to a parent node
-    void add_sub_node(Node<T>& parent_node, Node<T>& child_node) {
-        Node<T>* parent = find(root, parent_node.value);
+    void add_sub_node(NodeType& parent_node, NodeType& child_node) {
+        expand();  // A shared subtree must not change under its other parents
+        add_sub_node(find(root, parent_node.value), child_node.value);
+    }
+
+    // Add a child with the given value under a node of this tree, without searching for the parent;
+    // only the summaries along the path to the root are refreshed
+    NodeType* add_sub_node(NodeType* parent, const T& value) {
+        requireParentLinks();  // Expanding here would free the caller's node
         if (parent == nullptr || parent->children.size() >= K) {
             throw std::runtime_error("Parent node not found or maximum children exceeded.");
         }
-        Node<T>* new_child = new Node<T>(child_node.value);
+        NodeType* new_child = new NodeType(value);
+        this->on_allocate(1);
+        refreshNode(new_child);
         parent->add_child(new_child);
+        refreshPath(parent);
+        ++generation;
+        return new_child;
+    }
+
+    // Unlink a node and return its subtree as a tree of its own; no node is copied
+    Tree detach(NodeType* node) {
+        requireParentLinks();  // Expanding here would free the caller's node
+        requireMember(node);
+        Tree subtree;
+        subtree.combine = combine;  // The subtree's aggregates were folded with it
+        subtree.blocks = blocks;  // Its nodes may live in this tree's compacted blocks
+        if (node == root) {
+            root = nullptr;
+        } else {
+            NodeType* parent = node->parent;
+            unlink(node);
+            refreshPath(parent);
+        }
+        node->parent = nullptr;
+        node->sibling_index = 0;
+        subtree.root = node;  // Its summaries do not depend on the old ancestors
+        ++subtree.generation;
+        ++generation;
+        return subtree;
+    }
+
+    // Move a whole tree's nodes under `parent` as its last child, leaving `subtree` empty
+    void attach(NodeType* parent, Tree& subtree) {
+        requireParentLinks();
+        subtree.expand();
+        requireMember(parent);
+        if (&subtree == this || !subtree.root) {
+            throw std::runtime_error("Only a separate, non-empty tree can be attached.");
+        }
+        if (parent->children.size() >= K) {
+            throw std::runtime_error("Parent node not found or maximum children exceeded.");
+        }
+        parent->add_child(subtree.root);
+        if (combine || subtree.combine) {
+            refreshSubtree(subtree.root);  // Its aggregates were folded with the other tree's combine
+        }
+        for (const std::shared_ptr<NodeBlock>& block : subtree.blocks) {
+            // A detached subtree shares its origin's blocks; keep each one once so the list cannot grow
+            auto at = std::lower_bound(blocks.begin(), blocks.end(), block, blockBefore);
+            if (at == blocks.end() || *at != block) {
+                blocks.insert(at, block);
+            }
+        }
+        subtree.blocks.clear();
+        subtree.root = nullptr;
+        ++subtree.generation;
+        refreshPath(parent);
+        ++generation;
+    }
+
+    // Remove a node: with its whole subtree, or moving its children up into its place
+    void erase(NodeType* node, ErasePolicy policy = ErasePolicy::Subtree) {
+        requireParentLinks();
+        requireMember(node);
+        NodeType* parent = node->parent;
+        if (policy == ErasePolicy::Subtree) {
+            if (parent) {
+                unlink(node);
+            } else {
+                root = nullptr;
+            }
+            node->parent = nullptr;
+            clear(node);
+        } else if (!parent) {
+            if (node->children.size() > 1) {
+                throw std::runtime_error("Erasing the root this way needs at most one child to promote.");
+            }
+            root = node->children.empty() ? nullptr : node->children[0];
+            if (root) {
+                root->parent = nullptr;
+                root->sibling_index = 0;
+            }
+            destroyNode(node);
+        } else {
+            if (parent->children.size() - 1 + node->children.size() > K) {
+                throw std::runtime_error("Parent node not found or maximum children exceeded.");
+            }
+            // Splice the children into the node's slot, keeping their order
+            std::vector<NodeType*>& siblings = parent->children;
+            size_t at = node->sibling_index;
+            siblings.erase(siblings.begin() + static_cast<std::ptrdiff_t>(at));
+            siblings.insert(siblings.begin() + static_cast<std::ptrdiff_t>(at), node->children.begin(), node->children.end());
+            for (size_t i = at; i < siblings.size(); ++i) {
+                siblings[i]->parent = parent;
+                siblings[i]->sibling_index = static_cast<uint32_t>(i);
+            }
+            destroyNode(node);
+        }
+        if (parent) refreshPath(parent);
+        ++generation;
     }
 
     // Find a node with the given value
-    Node<T>* find(Node<T>* node, T value) {
-        if (!node) return nullptr;
-        if (node->value == value) return node;
-        for (Node<T>* child : node->children) {
-            Node<T>* result = find(child, value);
-            if (result) return result;
+    NodeType* find(NodeType* node, T value) {
+        // Pre-order with an explicit stack, so the first match is the same as a recursive search's
+        std::vector<NodeType*> stack;
+        if (node) stack.push_back(node);
+        while (!stack.empty()) {
+            NodeType* current = stack.back();
+            stack.pop_back();
+            this->on_probe();
+            if (current->value == value) return current;
+            for (auto it = current->children.rbegin(); it != current->children.rend(); ++it) {
+                if (*it) stack.push_back(*it);
+            }
         }
         return nullptr;
     }
 
     // Clear the tree
     void clear() {
-        clear(root);
+        if (compressed) {
+            // Shared nodes are reachable through several parents, so free each one exactly once
+            for (NodeType* node : shared_nodes) {
+                destroyNode(node);
+            }
+            shared_nodes.clear();
+            compressed = false;
+        } else {
+            clear(root);
+        }
         root = nullptr;
+        blocks.clear();  // Every node is gone, so no block is in use any more
+        ++generation;
     }
 
     // Clear a node and its children
-    void clear(Node<T>* node) {
-        if (!node) return;
-        for (Node<T>* child : node->children) {
-            clear(child);
+    void clear(NodeType* node) {
+        std::vector<NodeType*> stack;
+        if (node) stack.push_back(node);
+        while (!stack.empty()) {
+            NodeType* current = stack.back();
+            stack.pop_back();
+            for (NodeType* child : current->children) {
+                if (child) stack.push_back(child);
+            }
+            destroyNode(current);
         }
-        delete node;
     }
 
     // Get the root node
-    Node<T>* getRoot() const {
+    NodeType* getRoot() const {
         return root;
     }
 
+    // Write the tree to a versioned binary file (see tree_io.hpp)
+    void save(const std::string& path) const {
+        save_tree(root, path);
+    }
+
+    // Start a persistent version history from the current tree (see persistent_tree.hpp)
+    PersistentTree<T, K> persistent() const {
+        return PersistentTree<T, K>(root);
+    }
+
+    // Replace the tree with a copy of a persistent version
+    void restore(const PersistentTree<T, K>& version) {
+        adopt(version.template materialize<Summary>());
+    }
+
+    // Copy the tree into a forest's shared arena and return the copy's root handle (see forest.hpp)
+    typename Forest<T, K>::Handle copy_to(Forest<T, K>& forest) const {
+        return forest.copy_tree(root);
+    }
+
+    // Replace the tree with a copy of one tree of a forest
+    void restore(const Forest<T, K>& forest, typename Forest<T, K>::Handle tree_root) {
+        adopt(forest.template materialize<Summary>(tree_root));
+    }
+
+    // Encode a read-only copy in LOUDS form: ~2n bits of structure plus the values (see succinct_tree.hpp)
+    SuccinctTree<T> succinct() const {
+        return SuccinctTree<T>(root);
+    }
+
+    // Write the tree as fixed-size node pages for out-of-core use through PagedTree (see paged_tree.hpp)
+    void save_paged(const std::string& path, size_t nodes_per_page = 1024) const {
+        save_paged_tree(root, path, nodes_per_page);
+    }
+
+    // Replace the tree with the contents of a binary file written by save()
+    void load(const std::string& path) {
+        adopt(load_tree<T, Summary>(path, K));
+    }
+
+    // Replace the tree with an edge list file (`parent child` per line; names are values)
+    void import_edge_list(const std::string& path) {
+        TreeImporter<T, Summary> importer;
+        adopt(importer.edge_list(path, K));
+    }
+
+    // Replace the tree with a DOT file, in TreePrinter's id/label form or the value-named form
+    void import_dot(const std::string& path) {
+        TreeImporter<T, Summary> importer;
+        adopt(importer.dot(path, K));
+    }
+
+    // Hash-cons the tree: structurally identical subtrees are stored once and shared
+    void compress() {
+        if (!root || compressed) return;
+        std::unordered_map<size_t, std::vector<NodeType*>> table;
+        root = intern(root, table);
+        compressed = true;
+        ++generation;
+    }
+
+    // Undo compress(): give every shared subtree its own copy again
+    void expand() {
+        if (!compressed) return;
+        NodeType* copy = copyNode(root);
+        clear();
+        root = copy;
+        this->on_allocate(root->size);
+    }
+
+    // Structural hash of the whole tree (0 when empty)
+    size_t structural_hash() const {
+        return root ? root->hash : 0;
+    }
+
+    // Number of nodes in the tree, read from the root summary in O(1)
+    size_t size() const {
+        return root ? root->size : 0;
+    }
+
+    // Number of levels in the tree (0 when empty), read from the root summary in O(1)
+    size_t height() const {
+        return root ? root->height : 0;
+    }
+
+    // Install an associative combine; every node's aggregate then folds it over its subtree
+    void set_aggregate(std::function<T(const T&, const T&)> op) {
+        static_assert(std::is_base_of<AggregateSummary<T>, Summary>::value,
+                      "set_aggregate() needs a Tree with the AggregateSummary<T> policy");
+        combine = op;
+        refresh();
+    }
+
+    // The combine folded over the whole tree, read from the root summary in O(1)
+    const T& aggregate() const {
+        static_assert(std::is_base_of<AggregateSummary<T>, Summary>::value,
+                      "aggregate() needs a Tree with the AggregateSummary<T> policy");
+        if (!root) {
+            throw std::runtime_error("Aggregate of an empty tree.");
+        }
+        return root->aggregate;
+    }
+
+    // Recompute every subtree summary, e.g. after editing node children directly
+    void refresh() {
+        refreshSubtree(root);
+        ++generation;
+    }
+
+    // Counter that changes whenever the tree's structure may have changed
+    size_t get_generation() const {
+        return generation;
+    }
+
+    // Whether `ancestor` is an ancestor of (or the same node as) `node`; O(1) once indexed
+    bool is_ancestor(const NodeType* ancestor, const NodeType* node) {
+        return lcaIndex().is_ancestor(ancestor, node);
+    }
+
+    // Lowest common ancestor of two nodes; O(1) once indexed
+    NodeType* lca(const NodeType* a, const NodeType* b) {
+        return lcaIndex().lca(a, b);
+    }
+
+    // Depth of a node (the root has depth 0); O(1) once indexed
+    size_t depth(const NodeType* node) {
+        return lcaIndex().depth(node);
+    }
+
+    // Nodes from the root down to `node`, following parent links
+    std::vector<NodeType*> path_to_root(NodeType* node) const {
+        requireParentLinks();
+        std::vector<NodeType*> path;
+        for (; node; node = node->parent) {
+            path.push_back(node);
+        }
+        std::reverse(path.begin(), path.end());
+        return path;
+    }
+
+    // Pre-order walk from `start` (the root by default) calling visitor(node, depth), depth 0 at start.
+    // Nodes at max_depth are visited, but pruned subtrees and anything deeper are never reached;
+    // returns false if stopped.
+    template <typename Visitor>
+    bool visit(Visitor visitor, NodeType* start = nullptr, size_t max_depth = size_t(-1)) {
+        std::vector<std::pair<NodeType*, size_t>> stack;
+        if (!start) start = root;
+        if (start) stack.push_back(std::make_pair(start, size_t(0)));
+        while (!stack.empty()) {
+            NodeType* node = stack.back().first;
+            size_t depth = stack.back().second;
+            stack.pop_back();
+            this->on_visit();
+            VisitResult result = visitor(node, depth);
+            if (result == VisitResult::Stop) return false;
+            if (result == VisitResult::SkipChildren || depth >= max_depth) continue;
+            for (auto it = node->children.rbegin(); it != node->children.rend(); ++it) {
+                stack.push_back(std::make_pair(*it, depth + 1));
+            }
+            this->on_frontier(stack.size());
+        }
+        return true;
+    }
+
+    // Level-order counterpart of visit(): nodes come in BFS order with the same pruning rules
+    template <typename Visitor>
+    bool visit_bfs(Visitor visitor, NodeType* start = nullptr, size_t max_depth = size_t(-1)) {
+        std::queue<std::pair<NodeType*, size_t>> queue;
+        if (!start) start = root;
+        if (start) queue.push(std::make_pair(start, size_t(0)));
+        while (!queue.empty()) {
+            NodeType* node = queue.front().first;
+            size_t depth = queue.front().second;
+            queue.pop();
+            this->on_visit();
+            VisitResult result = visitor(node, depth);
+            if (result == VisitResult::Stop) return false;
+            if (result == VisitResult::SkipChildren || depth >= max_depth) continue;
+            for (NodeType* child : node->children) {
+                queue.push(std::make_pair(child, depth + 1));
+            }
+            this->on_frontier(queue.size());
+        }
+        return true;
+    }
+
+    // Internal iteration: f(node) for every node in the given order. The order is picked at compile
+    // time and f is inlined into a loop over a reserved vector stack (Level uses a flat queue instead).
+    template <Order O, typename F>
+    void for_each(F f) {
+        if (!root) return;
+        auto counted = [this, &f](NodeType* node) {
+            this->on_visit();
+            f(node);
+        };
+        forEach(counted, std::integral_constant<Order, O>());
+    }
+
+    // Move every node into one new allocation laid out in the given order (Pre, Post or Level),
+    // so scans in that order touch memory sequentially. Node pointers held outside the tree go stale.
+    void compact(Order order = Order::Pre) {
+        if (order == Order::In) {
+            throw std::runtime_error("compact() needs an order that visits every node.");
+        }
+        expand();
+        if (!root) return;
+        std::vector<NodeType*> old_nodes = sequence(order);
+        std::shared_ptr<NodeBlock> block = std::make_shared<NodeBlock>(old_nodes.size());
+        NodeType* fresh = block->nodes();
+        // Copy (not move) the values: if a copy throws, the new nodes are dropped and the tree is untouched
+        size_t built = 0;  // Nodes constructed in the block so far
+        try {
+            for (size_t i = 0; i < old_nodes.size(); ++i) {
+                NodeType* old = old_nodes[i];
+                NodeType* node = new (fresh + i) NodeType(old->value);
+                built = i + 1;
+                static_cast<Summary&>(*node) = *old;
+                node->parent = old->parent;
+                node->sibling_index = old->sibling_index;
+                node->children.reserve(old->children.size());  // Child arrays are allocated in order too
+            }
+        } catch (...) {
+            for (size_t i = 0; i < built; ++i) {
+                fresh[i].~NodeType();
+            }
+            throw;
+        }
+        // Each old node's parent field now names its copy, so links can be translated in place
+        for (size_t i = 0; i < old_nodes.size(); ++i) {
+            old_nodes[i]->parent = fresh + i;
+        }
+        for (size_t i = 0; i < old_nodes.size(); ++i) {
+            NodeType* node = fresh + i;
+            if (node->parent) node->parent = node->parent->parent;
+            for (NodeType* child : old_nodes[i]->children) {
+                node->children.push_back(child->parent);
+            }
+        }
+        root = root->parent;
+        for (NodeType* old : old_nodes) {
+            destroyNode(old);
+        }
+        blocks.assign(1, block);
+        this->on_allocate(old_nodes.size());
+        ++generation;
+    }
+
+    // Every node in the given order as one contiguous array, rebuilt only after a structural change.
+    // The reference stays valid until the next call for the same order.
+    const std::vector<NodeType*>& sequence(Order order) {
+        size_t slot = static_cast<size_t>(order);
+        if (sequence_generations[slot] != generation) {
+            std::vector<NodeType*>& nodes = sequences[slot];
+            nodes.clear();
+            nodes.reserve(size());
+            auto append = [&nodes](NodeType* node) { nodes.push_back(node); };
+            if (order == Order::Pre) {
+                for_each<Order::Pre>(append);
+            } else if (order == Order::Post) {
+                for_each<Order::Post>(append);
+            } else if (order == Order::In) {
+                for_each<Order::In>(append);
+            } else {
+                for_each<Order::Level>(append);
+            }
+            sequence_generations[slot] = generation;
+        }
+        return sequences[slot];
+    }
+
+    // Structural comparison in O(1) by Merkle root hash and size; see deep_equal() to rule out a collision
+    bool operator==(const Tree& other) const {
+        return structural_hash() == other.structural_hash() && size() == other.size();
+    }
+
+    // Structural comparison by a walk over both trees, which no hash collision can fool; O(n)
+    bool deep_equal(const Tree& other) const {
+        return same_subtree<T, Summary>(root, other.root);
+    }
+
+    bool operator!=(const Tree& other) const {
+        return !(*this == other);
+    }
+
+    // Number of compacted blocks this tree still references (see compact())
+    size_t block_count() const {
+        return blocks.size();
+    }
+
+    // Whether the tree is currently in its shared (hash-consed) form
+    bool is_compressed() const {
+        return compressed;
+    }
+
+    // Number of node allocations backing the tree (distinct subtrees while compressed)
+    size_t node_count() const {
+        if (compressed) return shared_nodes.size();
+        std::vector<NodeType*> nodes;
+        collectNodes(root, nodes);
+        return nodes.size();
+    }
+
+    // Bytes held by the nodes themselves, by their child vectors and by memoised sequences
+    TreeMemoryUsage memory_usage() const {
+        std::vector<NodeType*> nodes;
+        if (compressed) {
+            nodes = shared_nodes;
+        } else {
+            collectNodes(root, nodes);
+        }
+        TreeMemoryUsage usage = TreeMemoryUsage();
+        usage.nodes = nodes.size();
+        usage.node_bytes = nodes.size() * sizeof(NodeType);
+        for (const NodeType* node : nodes) {
+            usage.child_vector_bytes += node->children.capacity() * sizeof(NodeType*);
+        }
+        for (const std::vector<NodeType*>& sequence : sequences) {
+            usage.cache_bytes += sequence.capacity() * sizeof(NodeType*);
+        }
+        return usage;
+    }
+
+    // The instrumentation policy and its counters
+    const Instrumentation& instrumentation() const {
+        return *this;
+    }
+
+    Instrumentation& instrumentation() {
+        return *this;
+    }
+
     // Print the tree using TreePrinter
     void print() {
         TreePrinter<T, K> printer;
         printer.print(*this);
     }
 
+    // Iterators report visits and frontier sizes through this (an empty base when not instrumented)
+    typedef InstrumentationHook<Instrumentation> Hook;
+
     // Pre-Order Iterator
-    class PreOrderIterator {
+    class PreOrderIterator : private Hook {
     private:
-        std::stack<Node<T>*> stack;  // Stack to manage the nodes
+        std::stack<NodeType*> stack;  // Stack to manage the nodes
 
     public:
-        PreOrderIterator(Node<T>* root) {
+        PreOrderIterator(NodeType* root, Instrumentation* counters = nullptr) : Hook(counters) {
             if (root) stack.push(root);
         }
 
@@ -98,42 +671,45 @@ public:
         }
 
         PreOrderIterator& operator++() {
-            Node<T>* node = stack.top();
+            NodeType* node = stack.top();
             stack.pop();
             for (auto it = node->children.rbegin(); it != node->children.rend(); ++it) {
                 stack.push(*it);
             }
+            this->on_visit();
+            this->on_frontier(stack.size());
             return *this;
         }
 
-        Node<T>* operator*() const {
+        NodeType* operator*() const {
             return stack.top();
         }
 
-        Node<T>* operator->() const {
+        NodeType* operator->() const {
             return stack.top();
         }
     };
 
     // Post-Order Iterator
-    class PostOrderIterator {
+    class PostOrderIterator : private Hook {
     private:
-        std::stack<Node<T>*> stack;
-        std::stack<Node<T>*> output;
+        std::stack<NodeType*> stack;
+        std::stack<NodeType*> output;
 
     public:
-        PostOrderIterator(Node<T>* root) {
+        PostOrderIterator(NodeType* root, Instrumentation* counters = nullptr) : Hook(counters) {
             if (root) {
                 stack.push(root);
                 while (!stack.empty()) {
-                    Node<T>* node = stack.top();
+                    NodeType* node = stack.top();
                     stack.pop();
                     output.push(node);
-                    for (Node<T>* child : node->children) {
+                    for (NodeType* child : node->children) {
                         stack.push(child);
                     }
                 }
             }
+            this->on_frontier(output.size());  // Every node is collected up front
         }
 
         bool operator!=(const PostOrderIterator&) const {
@@ -142,26 +718,27 @@ public:
 
         PostOrderIterator& operator++() {
             output.pop();
+            this->on_visit();
             return *this;
         }
 
-        Node<T>* operator*() const {
+        NodeType* operator*() const {
             return output.top();
         }
 
-        Node<T>* operator->() const {
+        NodeType* operator->() const {
             return output.top();
         }
     };
 
     // In-Order Iterator (Binary tree specific)
-    class InOrderIterator {
+    class InOrderIterator : private Hook {
     private:
-        std::stack<Node<T>*> stack;
-        Node<T>* current;
+        std::stack<NodeType*> stack;
+        NodeType* current;
 
     public:
-        InOrderIterator(Node<T>* root) {
+        InOrderIterator(NodeType* root, Instrumentation* counters = nullptr) : Hook(counters) {
             stack.push(nullptr);
             while(root != nullptr) {
                 stack.push(root);
@@ -181,36 +758,38 @@ public:
         }
 
         InOrderIterator& operator++() {
-            Node<T>* node = stack.top();
+            NodeType* node = stack.top();
             stack.pop();
             if(node->children.size()>1 && node->children[1] != nullptr) {
-                Node<T>* right_child = node->children[1];
+                NodeType* right_child = node->children[1];
                 stack.push(right_child);
-                Node<T>* right_child_left_child = right_child;
+                NodeType* right_child_left_child = right_child;
                 while (right_child_left_child->children.size() > 0 && right_child_left_child->children[0] != nullptr) {
                     right_child_left_child = right_child_left_child->children[0];
                     stack.push(right_child_left_child);
                 }
             }
+            this->on_visit();
+            this->on_frontier(stack.size());
             return *this;
         }
 
-        Node<T>* operator*() const {
+        NodeType* operator*() const {
             return stack.top();
         }
 
-        Node<T>* operator->() const {
+        NodeType* operator->() const {
             return stack.top();
         }
     };
 
     // BFS Iterator
-    class BFSIterator {
+    class BFSIterator : private Hook {
     private:
-        std::queue<Node<T>*> queue;
+        std::queue<NodeType*> queue;
 
     public:
-        BFSIterator(Node<T>* root) {
+        BFSIterator(NodeType* root, Instrumentation* counters = nullptr) : Hook(counters) {
             if (root) queue.push(root);
         }
 
@@ -219,30 +798,32 @@ public:
         }
 
         BFSIterator& operator++() {
-            Node<T>* node = queue.front();
+            NodeType* node = queue.front();
             queue.pop();
-            for (Node<T>* child : node->children) {
+            for (NodeType* child : node->children) {
                 queue.push(child);
             }
+            this->on_visit();
+            this->on_frontier(queue.size());
             return *this;
         }
 
-        Node<T>* operator*() const {
+        NodeType* operator*() const {
             return queue.front();
         }
 
-        Node<T>* operator->() const {
+        NodeType* operator->() const {
             return queue.front();
         }
     };
 
     // DFS Iterator
-    class DFSIterator {
+    class DFSIterator : private Hook {
     private:
-        std::stack<Node<T>*> stack;
+        std::stack<NodeType*> stack;
 
     public:
-        DFSIterator(Node<T>* root) {
+        DFSIterator(NodeType* root, Instrumentation* counters = nullptr) : Hook(counters) {
             if (root) stack.push(root);
         }
 
@@ -251,63 +832,275 @@ public:
         }
 
         DFSIterator& operator++() {
-            Node<T>* node = stack.top();
+            NodeType* node = stack.top();
             stack.pop();
             for (auto it = node->children.rbegin(); it != node->children.rend(); ++it) {
                 stack.push(*it);
             }
+            this->on_visit();
+            this->on_frontier(stack.size());
             return *this;
         }
 
-        Node<T>* operator*() const {
+        NodeType* operator*() const {
             return stack.top();
         }
 
-        Node<T>* operator->() const {
+        NodeType* operator->() const {
             return stack.top();
         }
     };
 
+    // Stackless Pre-Order Iterator: walks parent/sibling links, so it holds two pointers and never allocates
+    class StacklessPreOrderIterator : private Hook {
+    private:
+        NodeType* top;  // Node the traversal started from
+        NodeType* current;
+
+    public:
+        StacklessPreOrderIterator(NodeType* start, Instrumentation* counters = nullptr)
+            : Hook(counters), top(start), current(start) {}
+
+        bool operator!=(const StacklessPreOrderIterator& other) const {
+            return current != other.current;
+        }
+
+        StacklessPreOrderIterator& operator++() {
+            this->on_visit();
+            if (!current->children.empty()) {
+                current = current->children[0];
+                return *this;
+            }
+            // Climb until some ancestor (below top) has a next sibling
+            while (current != top) {
+                NodeType* parent = current->parent;
+                if (current->sibling_index + 1 < parent->children.size()) {
+                    current = parent->children[current->sibling_index + 1];
+                    return *this;
+                }
+                current = parent;
+            }
+            current = nullptr;
+            return *this;
+        }
+
+        NodeType* operator*() const {
+            return current;
+        }
+
+        NodeType* operator->() const {
+            return current;
+        }
+    };
+
+    // Stackless DFS is the same walk as stackless pre-order
+    typedef StacklessPreOrderIterator StacklessDFSIterator;
+
+    // Stackless Post-Order Iterator
+    class StacklessPostOrderIterator : private Hook {
+    private:
+        NodeType* top;
+        NodeType* current;
+
+        static NodeType* leftmostLeaf(NodeType* node) {
+            while (node && !node->children.empty()) {
+                node = node->children[0];
+            }
+            return node;
+        }
+
+    public:
+        StacklessPostOrderIterator(NodeType* start, Instrumentation* counters = nullptr)
+            : Hook(counters), top(start), current(leftmostLeaf(start)) {}
+
+        bool operator!=(const StacklessPostOrderIterator& other) const {
+            return current != other.current;
+        }
+
+        StacklessPostOrderIterator& operator++() {
+            this->on_visit();
+            if (current == top) {
+                current = nullptr;
+                return *this;
+            }
+            NodeType* parent = current->parent;
+            if (current->sibling_index + 1 < parent->children.size()) {
+                current = leftmostLeaf(parent->children[current->sibling_index + 1]);
+            } else {
+                current = parent;
+            }
+            return *this;
+        }
+
+        NodeType* operator*() const {
+            return current;
+        }
+
+        NodeType* operator->() const {
+            return current;
+        }
+    };
+
+    // Stackless In-Order Iterator (Binary tree specific: children[0] is left, children[1] is right)
+    class StacklessInOrderIterator : private Hook {
+    private:
+        NodeType* top;
+        NodeType* current;
+
+        static NodeType* leftmost(NodeType* node) {
+            while (node && !node->children.empty()) {
+                node = node->children[0];
+            }
+            return node;
+        }
+
+    public:
+        StacklessInOrderIterator(NodeType* start, Instrumentation* counters = nullptr)
+            : Hook(counters), top(start), current(leftmost(start)) {}
+
+        bool operator!=(const StacklessInOrderIterator& other) const {
+            return current != other.current;
+        }
+
+        StacklessInOrderIterator& operator++() {
+            this->on_visit();
+            if (current->children.size() > 1) {
+                current = leftmost(current->children[1]);
+                return *this;
+            }
+            // Climb until we leave a left subtree; its parent is next
+            while (current != top) {
+                NodeType* parent = current->parent;
+                if (current->sibling_index == 0) {
+                    current = parent;
+                    return *this;
+                }
+                current = parent;
+            }
+            current = nullptr;
+            return *this;
+        }
+
+        NodeType* operator*() const {
+            return current;
+        }
+
+        NodeType* operator->() const {
+            return current;
+        }
+    };
+
+    // End marker for BestFirstIterator, which finishes when its frontier runs empty
+    struct BestFirstEnd {};
+
+    // Best-First Iterator: always yields the open node with the highest priority, and only then
+    // opens its children. A non-zero beam width caps the frontier by dropping its lowest entries.
+    template <typename Priority>
+    class BestFirstIterator : private Hook {
+    private:
+        typedef typename std::decay<decltype(std::declval<Priority&>()(std::declval<const NodeType*>()))>::type Score;
+
+        struct Entry {
+            Score score;
+            size_t order;  // Ties go to the node that was opened first
+            NodeType* node;
+
+            bool operator<(const Entry& other) const {
+                if (other.score < score) return true;
+                if (score < other.score) return false;
+                return order < other.order;
+            }
+        };
+
+        Priority priority;
+        size_t beam_width;
+        size_t opened;
+        std::multiset<Entry> frontier;  // Best first
+
+        void open(NodeType* node) {
+            frontier.insert(Entry{priority(node), opened++, node});
+            if (beam_width && frontier.size() > beam_width) {
+                frontier.erase(std::prev(frontier.end()));
+            }
+        }
+
+    public:
+        BestFirstIterator(NodeType* root, Priority priority, size_t beam_width, Instrumentation* counters = nullptr)
+            : Hook(counters), priority(priority), beam_width(beam_width), opened(0) {
+            if (root) open(root);
+        }
+
+        bool operator!=(const BestFirstEnd&) const {
+            return !frontier.empty();
+        }
+
+        BestFirstIterator& operator++() {
+            NodeType* node = frontier.begin()->node;
+            frontier.erase(frontier.begin());
+            for (NodeType* child : node->children) {
+                open(child);
+            }
+            this->on_visit();
+            this->on_frontier(frontier.size());
+            return *this;
+        }
+
+        NodeType* operator*() const {
+            return frontier.begin()->node;
+        }
+
+        NodeType* operator->() const {
+            return frontier.begin()->node;
+        }
+
+        // Number of nodes currently waiting to be expanded
+        size_t frontier_size() const {
+            return frontier.size();
+        }
+    };
+
     // Heap Iterator (for min-heap conversion)
-    class HeapIterator {
+    class HeapIterator : private Hook {
     private:
-        std::vector<Node<T>*> heap;  // Vector to store heap nodes
+        std::vector<NodeType*> heap;  // Vector to store heap nodes
         size_t index;  // Index for current node in the heap
 
     public:
-        HeapIterator(Node<T>* root) {
+        HeapIterator(NodeType* root, Instrumentation* counters = nullptr) : Hook(counters) {
             index = 0;
             if (root == nullptr) {
                 return;
             }
 
             // Collect all nodes in the tree using BFS
-            std::queue<Node<T>*> node_queue;
+            std::queue<NodeType*> node_queue;
             node_queue.push(root);
 
             while (!node_queue.empty()) {
-                Node<T>* current_node = node_queue.front();
+                NodeType* current_node = node_queue.front();
                 node_queue.pop();
                 heap.push_back(current_node);
-                for (Node<T>* child : current_node->children) {
+                for (NodeType* child : current_node->children) {
                     node_queue.push(child);
                 }
             }
 
             // Convert the vector to a min-heap
-            std::make_heap(heap.begin(), heap.end(), [](Node<T>* a, Node<T>* b) { return a->get_value() > b->get_value(); });
+            std::make_heap(heap.begin(), heap.end(), [](NodeType* a, NodeType* b) { return a->get_value() > b->get_value(); });
+            this->on_frontier(heap.size());
         }
 
         T& operator*() { return heap.front()->get_value(); }
 
-        Node<T>* operator->() { return heap.front(); }
+        NodeType* operator->() { return heap.front(); }
 
         HeapIterator& operator++() {
             if (heap.empty()) {
                 return *this;
             }
-            std::pop_heap(heap.begin(), heap.end(), [](Node<T>* a, Node<T>* b) { return a->get_value() > b->get_value(); });
+            std::pop_heap(heap.begin(), heap.end(), [](NodeType* a, NodeType* b) { return a->get_value() > b->get_value(); });
             heap.pop_back();
+            this->on_visit();
             return *this;
         }
 
@@ -316,53 +1109,356 @@ public:
     };
 
     // Iterator functions
-    PreOrderIterator begin_pre_order() { return PreOrderIterator(root); }
+    PreOrderIterator begin_pre_order() { return PreOrderIterator(root, this); }
     PreOrderIterator end_pre_order() { return PreOrderIterator(nullptr); }
 
-    PostOrderIterator begin_post_order() { return PostOrderIterator(root); }
+    PostOrderIterator begin_post_order() { return PostOrderIterator(root, this); }
     PostOrderIterator end_post_order() { return PostOrderIterator(nullptr); }
 
-    InOrderIterator begin_in_order() { return InOrderIterator(root); }
+    InOrderIterator begin_in_order() { return InOrderIterator(root, this); }
     InOrderIterator end_in_order() { return InOrderIterator(nullptr); }
 
-    BFSIterator begin_bfs_scan() { return BFSIterator(root); }
+    BFSIterator begin_bfs_scan() { return BFSIterator(root, this); }
     BFSIterator end_bfs_scan() { return BFSIterator(nullptr); }
 
-    DFSIterator begin_dfs_scan() { return DFSIterator(root); }
+    DFSIterator begin_dfs_scan() { return DFSIterator(root, this); }
     DFSIterator end_dfs_scan() { return DFSIterator(nullptr); }
 
-    HeapIterator begin_heap() { return HeapIterator(root); }
+    // priority(const NodeType*) returns any comparable score; higher is expanded first (0 = unlimited beam)
+    template <typename Priority>
+    BestFirstIterator<Priority> begin_best_first(Priority priority, size_t beam_width = 0) {
+        return BestFirstIterator<Priority>(root, priority, beam_width, this);
+    }
+    BestFirstEnd end_best_first() { return BestFirstEnd(); }
+
+    HeapIterator begin_heap() { return HeapIterator(root, this); }
     HeapIterator end_heap() { return HeapIterator(nullptr); }
 
+    StacklessPreOrderIterator begin_stackless_pre_order() { requireParentLinks(); return StacklessPreOrderIterator(root, this); }
+    StacklessPreOrderIterator end_stackless_pre_order() { return StacklessPreOrderIterator(nullptr); }
+
+    StacklessPostOrderIterator begin_stackless_post_order() { requireParentLinks(); return StacklessPostOrderIterator(root, this); }
+    StacklessPostOrderIterator end_stackless_post_order() { return StacklessPostOrderIterator(nullptr); }
+
+    StacklessInOrderIterator begin_stackless_in_order() { requireParentLinks(); return StacklessInOrderIterator(root, this); }
+    StacklessInOrderIterator end_stackless_in_order() { return StacklessInOrderIterator(nullptr); }
+
+    StacklessDFSIterator begin_stackless_dfs_scan() { requireParentLinks(); return StacklessDFSIterator(root, this); }
+    StacklessDFSIterator end_stackless_dfs_scan() { return StacklessDFSIterator(nullptr); }
+
     // Transform the tree into a minimum heap
     void myHeap() {
-        std::vector<Node<T>*> nodes;
+        expand();
+        std::vector<NodeType*> nodes;
         collectNodes(root, nodes);
-        std::make_heap(nodes.begin(), nodes.end(), [](Node<T>* a, Node<T>* b) { return a->value > b->value; });
+        std::make_heap(nodes.begin(), nodes.end(), [](NodeType* a, NodeType* b) { return a->value > b->value; });
         buildHeap(nodes);
+        // Every node may have moved, so rebuild the summaries bottom-up (heap order is BFS order)
+        for (auto it = nodes.rbegin(); it != nodes.rend(); ++it) {
+            refreshNode(*it);
+        }
+        ++generation;
     }
 
 private:
+    // Shared nodes have several parents, so parent links are only meaningful on the expanded tree
+    void requireParentLinks() const {
+        if (compressed) {
+            throw std::runtime_error("Parent links need the expanded tree.");
+        }
+    }
+
+    // The depth-first loops keep their own stack, reserved up front from the root's height, so they
+    // never read parent links and also walk the compressed form
+    template <typename F>
+    void forEach(F& f, std::integral_constant<Order, Order::Pre>) {
+        std::vector<NodeType*> stack;  // Right siblings still to visit
+        stack.reserve(std::min(height() * size_t(K - 1) + 1, size()));
+        NodeType* node = root;
+        while (true) {
+            f(node);
+            const std::vector<NodeType*>& children = node->children;
+            size_t count = children.size();
+            if (count != 0) {
+                for (size_t i = count - 1; i > 0; --i) stack.push_back(children[i]);
+                node = children[0];
+                continue;
+            }
+            if (stack.empty()) return;
+            node = stack.back();
+            stack.pop_back();
+        }
+    }
+
+    template <typename F>
+    void forEach(F& f, std::integral_constant<Order, Order::Post>) {
+        struct Frame {
+            NodeType* node;
+            NodeType* const* next;  // Next child to descend into
+            NodeType* const* end;
+        };
+        std::vector<Frame> stack;  // One frame per ancestor still waiting for its children
+        stack.reserve(height());
+        NodeType* node = root;
+        while (true) {
+            while (!node->children.empty()) {
+                const std::vector<NodeType*>& children = node->children;
+                Frame frame = { node, children.data() + 1, children.data() + children.size() };
+                stack.push_back(frame);
+                node = children[0];
+            }
+            f(node);
+            // Finish ancestors until one still has a child left
+            while (true) {
+                if (stack.empty()) return;
+                Frame& top = stack.back();
+                if (top.next != top.end) {
+                    node = *top.next++;
+                    break;
+                }
+                f(top.node);
+                stack.pop_back();
+            }
+        }
+    }
+
+    template <typename F>
+    void forEach(F& f, std::integral_constant<Order, Order::In>) {
+        std::vector<NodeType*> stack;  // Ancestors whose left subtree is being walked
+        stack.reserve(height());
+        NodeType* node = root;
+        while (true) {
+            while (node != nullptr) {
+                stack.push_back(node);
+                node = node->children.empty() ? nullptr : node->children[0];
+            }
+            if (stack.empty()) return;
+            node = stack.back();
+            stack.pop_back();
+            f(node);
+            node = node->children.size() > 1 ? node->children[1] : nullptr;
+        }
+    }
+
+    template <typename F>
+    void forEach(F& f, std::integral_constant<Order, Order::Level>) {
+        std::vector<NodeType*> queue;  // Never popped: a read index walks it
+        queue.reserve(size());
+        queue.push_back(root);
+        for (size_t head = 0; head < queue.size(); ++head) {
+            NodeType* node = queue[head];
+            f(node);
+            queue.insert(queue.end(), node->children.begin(), node->children.end());
+            this->on_frontier(queue.size() - head - 1);
+        }
+    }
+
+    static bool blockBefore(const std::shared_ptr<NodeBlock>& a, const std::shared_ptr<NodeBlock>& b) {
+        return std::less<const char*>()(a->memory, b->memory);
+    }
+
+    // Whether `node` lives in one of the blocks: a binary search for the last block starting at or
+    // before it, so freeing a tree costs O(n log blocks)
+    bool inBlock(const NodeType* node) const {
+        auto after = std::upper_bound(blocks.begin(), blocks.end(), node,
+                                      [](const NodeType* target, const std::shared_ptr<NodeBlock>& block) {
+                                          return std::less<const NodeType*>()(target, block->nodes());
+                                      });
+        return after != blocks.begin() && (*(after - 1))->contains(node);
+    }
+
+    // Free one node, whether it was allocated on its own or lives in a compacted block
+    void destroyNode(NodeType* node) {
+        this->on_release(1);
+        if (inBlock(node)) {
+            node->~NodeType();
+        } else {
+            delete node;
+        }
+    }
+
+    // Throw unless `node` belongs to this tree. Only debug builds walk the parent links to check (O(depth));
+    // with NDEBUG a foreign node is a precondition violation, like a failed assert, and only null is refused
+    void requireMember(const NodeType* node) const {
+        if (!node) {
+            throw std::runtime_error("Node does not belong to this tree.");
+        }
+#ifndef NDEBUG
+        const NodeType* top = node;
+        while (top->parent) top = top->parent;
+        if (top != root) {
+            throw std::runtime_error("Node does not belong to this tree.");
+        }
+#endif
+    }
+
+    // Take a node out of its parent's child list, renumbering the later siblings (O(K))
+    void unlink(NodeType* node) {
+        std::vector<NodeType*>& siblings = node->parent->children;
+        siblings.erase(siblings.begin() + static_cast<std::ptrdiff_t>(node->sibling_index));
+        for (size_t i = node->sibling_index; i < siblings.size(); ++i) {
+            siblings[i]->sibling_index = static_cast<uint32_t>(i);
+        }
+    }
+
+    // Only the summaries on the path from `node` up to the root change after a local edit
+    void refreshPath(NodeType* node) {
+        for (; node; node = node->parent) {
+            refreshNode(node);
+        }
+    }
+
+    // The ancestor/LCA index, rebuilt if the tree changed since it was last built
+    const LcaIndex<T, Summary>& lcaIndex() {
+        if (compressed) {
+            throw std::runtime_error("Ancestor queries need the expanded tree.");
+        }
+        if (lca_generation != generation) {
+            lca_index.build(root);
+            lca_generation = generation;
+        }
+        return lca_index;
+    }
+
     // Collect nodes for heap transformation
-    void collectNodes(Node<T>* node, std::vector<Node<T>*>& nodes) {
+    void collectNodes(NodeType* node, std::vector<NodeType*>& nodes) const {
+        std::vector<NodeType*> stack;
+        if (node) stack.push_back(node);
+        while (!stack.empty()) {
+            NodeType* current = stack.back();
+            stack.pop_back();
+            nodes.push_back(current);
+            for (auto it = current->children.rbegin(); it != current->children.rend(); ++it) {
+                if (*it) stack.push_back(*it);
+            }
+        }
+    }
+
+    // Recompute a node's summaries (hash, size, height, then the policy's own) from its children's
+    void refreshNode(NodeType* node) {
+        size_t hash = hash_combine(std::hash<T>()(node->value), node->children.size());
+        size_t size = 1;
+        size_t height = 0;
+        for (const NodeType* child : node->children) {
+            hash = hash_combine(hash, child->hash);
+            size += child->size;
+            height = std::max(height, child->height);
+        }
+        node->hash = hash;
+        node->size = size;
+        node->height = height + 1;
+        Summary::fold(node, combine);
+    }
+
+    // Bulk construction path: take ownership of a fully linked tree and compute its summaries
+    void adopt(NodeType* new_root) {
+        clear();
+        root = new_root;
+        if (root) {
+            root->parent = nullptr;
+            root->sibling_index = 0;
+        }
+        refreshPreOrder();
+        this->on_allocate(root ? root->size : 0);
+    }
+
+    // Recompute every summary without recursion: children follow their parent in pre-order
+    void refreshPreOrder() {
+        std::vector<NodeType*> nodes;
+        for (auto it = begin_stackless_pre_order(); it != end_stackless_pre_order(); ++it) {
+            nodes.push_back(*it);
+        }
+        for (auto it = nodes.rbegin(); it != nodes.rend(); ++it) {
+            refreshNode(*it);
+        }
+        ++generation;
+    }
+
+    // Recompute the summaries of a whole subtree bottom-up (children follow their parent in pre-order)
+    void refreshSubtree(NodeType* node) {
         if (!node) return;
-        nodes.push_back(node);
-        for (Node<T>* child : node->children) {
-            collectNodes(child, nodes);
+        std::vector<NodeType*> nodes;
+        visit([&nodes](NodeType* visited, size_t) {
+            nodes.push_back(visited);
+            return VisitResult::Continue;
+        }, node);
+        for (auto it = nodes.rbegin(); it != nodes.rend(); ++it) {
+            refreshNode(*it);
+        }
+    }
+
+    // Replace a subtree (bottom-up, with an explicit stack) by its canonical shared copy, freeing the duplicates
+    NodeType* intern(NodeType* node, std::unordered_map<size_t, std::vector<NodeType*>>& table) {
+        struct Frame { NodeType* node; size_t next; };  // `next`: first child not interned yet
+        std::vector<Frame> stack(1, Frame{node, 0});
+        NodeType* canonical = nullptr;
+        while (!stack.empty()) {
+            Frame& frame = stack.back();
+            if (frame.next < frame.node->children.size()) {
+                NodeType* child = frame.node->children[frame.next++];
+                stack.push_back(Frame{child, 0});
+                continue;
+            }
+            canonical = internNode(frame.node, table);
+            stack.pop_back();
+            if (!stack.empty()) {
+                stack.back().node->children[stack.back().next - 1] = canonical;
+            }
+        }
+        return canonical;
+    }
+
+    // Intern one node whose children are already canonical
+    NodeType* internNode(NodeType* node, std::unordered_map<size_t, std::vector<NodeType*>>& table) {
+        refreshNode(node);
+        std::vector<NodeType*>& bucket = table[node->hash];
+        for (NodeType* candidate : bucket) {
+            // Children are already canonical, so identical subtrees have identical child pointers
+            if (candidate->value == node->value && candidate->children == node->children) {
+                destroyNode(node);
+                return candidate;
+            }
         }
+        bucket.push_back(node);
+        shared_nodes.push_back(node);
+        return node;
+    }
+
+    // Deep-copy a (possibly shared) subtree into freshly allocated nodes
+    NodeType* copyNode(const NodeType* node) const {
+        NodeType* result = new NodeType(node->value);
+        static_cast<Summary&>(*result) = *node;
+        std::vector<std::pair<const NodeType*, NodeType*>> stack(1, std::make_pair(node, result));
+        while (!stack.empty()) {
+            const NodeType* from = stack.back().first;
+            NodeType* to = stack.back().second;
+            stack.pop_back();
+            to->children.reserve(from->children.size());
+            for (const NodeType* child : from->children) {
+                NodeType* copy = new NodeType(child->value);
+                static_cast<Summary&>(*copy) = *child;
+                to->add_child(copy);
+                stack.push_back(std::make_pair(child, copy));
+            }
+        }
+        return result;
     }
 
     // Build the heap from collected nodes
-    void buildHeap(const std::vector<Node<T>*>& nodes) {
+    void buildHeap(const std::vector<NodeType*>& nodes) {
         if (nodes.empty()) return;
+        for (NodeType* node : nodes) {
+            node->children.clear();  // Leaves never reach the loop below and must not keep old links
+        }
         root = nodes[0];
-        std::queue<Node<T>*> queue;
+        root->parent = nullptr;
+        root->sibling_index = 0;
+        std::queue<NodeType*> queue;
         queue.push(root);
         size_t index = 1;
         while (!queue.empty() && index < nodes.size()) {
-            Node<T>* node = queue.front();
+            NodeType* node = queue.front();
             queue.pop();
-            node->children.clear();
             for (int i = 0; i < K && index < nodes.size(); ++i) {
                 node->add_child(nodes[index++]);
                 queue.push(node->children.back());
@@ -371,6 +1467,59 @@ private:
     }
 };
 
+// Kind of change reported by diff()
+enum class DiffKind {
+    Added,    // Subtree exists only in the second tree
+    Removed,  // Subtree exists only in the first tree
+    Changed   // Node exists in both trees but holds a different value
+};
+
+// A changed region found by diff(); the untouched side is nullptr for Added/Removed
+template <typename T, typename Summary = StructuralSummary>
+struct NodeDiff {
+    DiffKind kind;
+    Node<T, Summary>* before;
+    Node<T, Summary>* after;
+};
+
+// Compare two subtrees child-by-child, skipping every pair whose Merkle hashes match
+template <typename T, typename Summary>
+void diffNodes(Node<T, Summary>* before, Node<T, Summary>* after, std::vector<NodeDiff<T, Summary>>& result) {
+    // Pre-order over node pairs with an explicit stack, so deep trees do not exhaust the call stack
+    std::vector<std::pair<Node<T, Summary>*, Node<T, Summary>*>> stack(1, std::make_pair(before, after));
+    while (!stack.empty()) {
+        Node<T, Summary>* left = stack.back().first;
+        Node<T, Summary>* right = stack.back().second;
+        stack.pop_back();
+        if (!left && !right) continue;
+        if (!right) {
+            result.push_back(NodeDiff<T, Summary>{DiffKind::Removed, left, nullptr});
+            continue;
+        }
+        if (!left) {
+            result.push_back(NodeDiff<T, Summary>{DiffKind::Added, nullptr, right});
+            continue;
+        }
+        if (left->hash == right->hash) continue;  // Identical subtree
+        if (!(left->value == right->value)) {
+            result.push_back(NodeDiff<T, Summary>{DiffKind::Changed, left, right});
+        }
+        for (size_t i = std::max(left->children.size(), right->children.size()); i-- > 0;) {
+            stack.push_back(std::make_pair(i < left->children.size() ? left->children[i] : nullptr,
+                                           i < right->children.size() ? right->children[i] : nullptr));
+        }
+    }
+}
+
+// Report the regions in which two trees differ; identical subtrees are skipped by hash, so the cost follows the changes
+template <typename T, int K, typename Instrumentation, typename Summary>
+std::vector<NodeDiff<T, Summary>> diff(const Tree<T, K, Instrumentation, Summary>& a,
+                                       const Tree<T, K, Instrumentation, Summary>& b) {
+    std::vector<NodeDiff<T, Summary>> result;
+    diffNodes(a.getRoot(), b.getRoot(), result);
+    return result;
+}
+
 #endif // TREE_HPP
 
 
@@ -0,0 +1,412 @@
+// minnesav@gmail.com
+
+#ifndef TREE_IMPORT_HPP
+#define TREE_IMPORT_HPP
+
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <sstream>
+#include <vector>
+#include <stdexcept>
+#include <type_traits>
+#include "node.hpp"
+#include "tree_io.hpp"
+
+/**
+ * @brief A span of characters inside the mapped input; never owns memory.
+ */
+struct TextSlice {
+    const char* data;
+    size_t size;
+
+    bool operator==(const TextSlice& other) const {
+        return size == other.size && std::memcmp(data, other.data, size) == 0;
+    }
+};
+
+/**
+ * @brief FNV-1a hash over a TextSlice, so node names can be looked up without copying them.
+ */
+struct TextSliceHash {
+    size_t operator()(const TextSlice& slice) const {
+        uint64_t hash = 14695981039346656037ULL;
+        for (size_t i = 0; i < slice.size; ++i) {
+            hash = (hash ^ static_cast<unsigned char>(slice.data[i])) * 1099511628211ULL;
+        }
+        return static_cast<size_t>(hash);
+    }
+};
+
+/**
+ * @brief Converts label text into a node value.
+ *
+ * Integers are parsed by hand and rejected when they do not fit T, floating point
+ * values go through strtod on a small stack copy, strings are unescaped, and any
+ * other type goes through operator>>.
+ *
+ * @tparam T The type of the values stored in the tree nodes.
+ */
+template <typename T>
+struct ValueParser {
+    // 0: integer, 1: floating point, 2: std::string, 3: anything with operator>>
+    typedef std::integral_constant<int,
+        std::is_integral<T>::value && !std::is_same<T, char>::value && !std::is_same<T, bool>::value ? 0 :
+        std::is_floating_point<T>::value ? 1 :
+        std::is_same<T, std::string>::value ? 2 : 3> Kind;
+
+    static T parse(const TextSlice& text) {
+        return parse(text, Kind());
+    }
+
+    static T parse(const TextSlice& text, std::integral_constant<int, 0>) {
+        size_t i = 0;
+        bool negative = false;
+        if (i < text.size && (text.data[i] == '-' || text.data[i] == '+')) {
+            negative = text.data[i++] == '-';
+        }
+        if (i == text.size) fail(text);
+        // Largest magnitude T can hold with this sign (only zero for a negative unsigned value)
+        unsigned long long limit = static_cast<unsigned long long>(std::numeric_limits<T>::max());
+        if (negative) limit = std::is_signed<T>::value ? limit + 1 : 0;
+        unsigned long long number = 0;
+        for (; i < text.size; ++i) {
+            char c = text.data[i];
+            if (c < '0' || c > '9') fail(text);
+            unsigned long long digit = static_cast<unsigned long long>(c - '0');
+            if (digit > limit || number > (limit - digit) / 10) {
+                throw std::runtime_error("Node value is out of range: " + std::string(text.data, text.size));
+            }
+            number = number * 10 + digit;
+        }
+        return negative ? static_cast<T>(0ULL - number) : static_cast<T>(number);
+    }
+
+    static T parse(const TextSlice& text, std::integral_constant<int, 1>) {
+        char buffer[64];
+        if (text.size == 0 || text.size >= sizeof(buffer)) fail(text);
+        std::memcpy(buffer, text.data, text.size);
+        buffer[text.size] = '\0';
+        char* end = nullptr;
+        double number = std::strtod(buffer, &end);
+        if (end != buffer + text.size) fail(text);
+        return static_cast<T>(number);
+    }
+
+    static T parse(const TextSlice& text, std::integral_constant<int, 2>) {
+        return unescape(text);
+    }
+
+    static T parse(const TextSlice& text, std::integral_constant<int, 3>) {
+        std::istringstream stream(unescape(text));
+        T value;
+        if (!(stream >> value)) fail(text);
+        return value;
+    }
+
+    // Undo the DOT escaping of quotes and backslashes
+    static std::string unescape(const TextSlice& text) {
+        std::string result;
+        result.reserve(text.size);
+        for (size_t i = 0; i < text.size; ++i) {
+            if (text.data[i] == '\\' && i + 1 < text.size) ++i;
+            result.push_back(text.data[i]);
+        }
+        return result;
+    }
+
+    static void fail(const TextSlice& text) {
+        throw std::runtime_error("Could not parse node value: " + std::string(text.data, text.size));
+    }
+};
+
+/**
+ * @brief Streaming importer for edge lists and the DOT files TreePrinter writes.
+ *
+ * The input is memory-mapped and scanned once; names are hashed as slices of the
+ * mapping, so no per-line strings are allocated. Nodes are created and linked in
+ * bulk at the end, in the order the edges appear.
+ *
+ * @tparam T The type of the values stored in the tree nodes.
+ * @tparam Summary The summary policy of the nodes (see summary.hpp).
+ */
+template <typename T, typename Summary = StructuralSummary>
+class TreeImporter {
+public:
+    /**
+     * @brief Reads an edge list: one `parent child` pair per line.
+     *
+     * Names are separated by whitespace (optionally with `->` between them) and may
+     * be double-quoted; blank lines and lines starting with `#` are ignored. Each
+     * name is also the node's value.
+     *
+     * @param path The file to read.
+     * @param max_children The arity limit of the receiving tree.
+     * @return Node<T, Summary>* The new root (nullptr for an empty input); the caller owns the nodes.
+     */
+    Node<T, Summary>* edge_list(const std::string& path, size_t max_children) {
+        MappedFile file(path);
+        reset();
+        const char* p = file.begin();
+        const char* end = file.end();
+        while (p < end) {
+            skipBlanks(p, end);
+            if (p == end) break;
+            if (*p == '\n' || *p == '\r') {
+                ++p;
+                continue;
+            }
+            if (*p == '#') {
+                skipLine(p, end);
+                continue;
+            }
+            TextSlice parent = token(p, end);
+            skipBlanks(p, end);
+            if (end - p >= 2 && p[0] == '-' && p[1] == '>') {
+                p += 2;
+                skipBlanks(p, end);
+            }
+            TextSlice child = token(p, end);
+            if (!parent.size || !child.size) {
+                throw std::runtime_error("Malformed edge list line.");
+            }
+            addEdge(intern(parent), intern(child));
+            skipLine(p, end);
+        }
+        return build(max_children);
+    }
+
+    /**
+     * @brief Reads a DOT digraph made of `a -> b;` edges and `a [label="..."];` nodes.
+     *
+     * Both the value-named form (`"3.1" -> "2.2";`) and TreePrinter's id form
+     * (`n0 [label="3.1"]; n0 -> n1;`) are accepted. A node without a label takes its
+     * name as its value; graph-level statements such as `node [shape=circle];` are skipped.
+     *
+     * @param path The file to read.
+     * @param max_children The arity limit of the receiving tree.
+     * @return Node<T, Summary>* The new root (nullptr for an empty graph); the caller owns the nodes.
+     */
+    Node<T, Summary>* dot(const std::string& path, size_t max_children) {
+        MappedFile file(path);
+        reset();
+        const char* p = file.begin();
+        const char* end = file.end();
+        while (p < end) {
+            skipSpace(p, end);
+            if (p == end) break;
+            char c = *p;
+            if (c == ';' || c == '{' || c == '}') {
+                ++p;
+                continue;
+            }
+            if (c == '/' && p + 1 < end && p[1] == '/') {
+                skipLine(p, end);
+                continue;
+            }
+            bool quoted = c == '"';
+            TextSlice first = token(p, end);
+            if (!first.size && !quoted) {
+                throw std::runtime_error("Malformed DOT statement.");
+            }
+            skipSpace(p, end);
+            if (!quoted && is(first, "strict")) {
+                continue;
+            }
+            if (!quoted && (is(first, "digraph") || is(first, "graph"))) {
+                if (p < end && *p == '[') {
+                    attributes(p, end);  // Graph attributes
+                } else if (p < end && *p != '{') {
+                    token(p, end);  // Graph name
+                }
+                continue;
+            }
+            if (!quoted && (is(first, "node") || is(first, "edge"))) {
+                attributes(p, end);  // Defaults for all nodes or edges carry no tree data
+                continue;
+            }
+            if (end - p >= 2 && p[0] == '-' && p[1] == '>') {
+                p += 2;
+                skipSpace(p, end);
+                TextSlice second = token(p, end);
+                addEdge(intern(first), intern(second));
+                skipSpace(p, end);
+                attributes(p, end);
+            } else {
+                size_t id = intern(first);
+                TextSlice label = attributes(p, end);
+                if (label.data) labels[id] = label;
+            }
+        }
+        return build(max_children);
+    }
+
+private:
+    std::vector<TextSlice> names;  // Name per node index
+    std::vector<TextSlice> labels;  // Value text per node index
+    std::vector<size_t> hashes;  // Name hash per node index
+    std::vector<size_t> slots;  // Open-addressing name table: node index + 1, or 0 when empty
+    std::vector<std::pair<size_t, size_t>> edges;  // (parent, child) in input order
+
+    // Start small whatever the input size: the name table doubles in grow() and the vectors grow
+    // geometrically, so memory follows the nodes actually found
+    void reset() {
+        names.clear();
+        labels.clear();
+        hashes.clear();
+        edges.clear();
+        slots.assign(1024, 0);
+    }
+
+    // Node index for a name, creating the node on first sight (linear probing, load <= 1/2)
+    size_t intern(const TextSlice& name) {
+        size_t hash = TextSliceHash()(name);
+        size_t mask = slots.size() - 1;
+        for (size_t slot = hash & mask;; slot = (slot + 1) & mask) {
+            size_t entry = slots[slot];
+            if (entry == 0) {
+                slots[slot] = names.size() + 1;
+                names.push_back(name);
+                labels.push_back(name);
+                hashes.push_back(hash);
+                if (names.size() * 2 > slots.size()) grow();
+                return names.size() - 1;
+            }
+            if (hashes[entry - 1] == hash && names[entry - 1] == name) {
+                return entry - 1;
+            }
+        }
+    }
+
+    void grow() {
+        slots.assign(slots.size() * 2, 0);
+        size_t mask = slots.size() - 1;
+        for (size_t index = 0; index < names.size(); ++index) {
+            size_t slot = hashes[index] & mask;
+            while (slots[slot]) slot = (slot + 1) & mask;
+            slots[slot] = index + 1;
+        }
+    }
+
+    void addEdge(size_t parent, size_t child) {
+        edges.push_back(std::make_pair(parent, child));
+    }
+
+    static bool is(const TextSlice& slice, const char* word) {
+        return slice.size == std::strlen(word) && std::memcmp(slice.data, word, slice.size) == 0;
+    }
+
+    static void skipBlanks(const char*& p, const char* end) {
+        while (p < end && (*p == ' ' || *p == '\t')) ++p;
+    }
+
+    static void skipSpace(const char*& p, const char* end) {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r' || *p == ',')) ++p;
+    }
+
+    static void skipLine(const char*& p, const char* end) {
+        while (p < end && *p != '\n') ++p;
+        if (p < end) ++p;
+    }
+
+    // A double-quoted string (without its quotes, escapes kept) or a bare word
+    static TextSlice token(const char*& p, const char* end) {
+        if (p < end && *p == '"') {
+            const char* start = ++p;
+            while (p < end && *p != '"') {
+                if (*p == '\\' && p + 1 < end) ++p;
+                ++p;
+            }
+            if (p == end) {
+                throw std::runtime_error("Unterminated quoted name.");
+            }
+            TextSlice slice = {start, static_cast<size_t>(p - start)};
+            ++p;
+            return slice;
+        }
+        const char* start = p;
+        while (p < end && !std::strchr(" \t\r\n;[]{}=,\"", *p) && !(*p == '-' && p + 1 < end && p[1] == '>')) ++p;
+        return TextSlice{start, static_cast<size_t>(p - start)};
+    }
+
+    // Skip an optional `[key=value, ...]` list, returning the label value if present
+    static TextSlice attributes(const char*& p, const char* end) {
+        TextSlice label = {nullptr, 0};
+        if (p == end || *p != '[') return label;
+        ++p;
+        while (true) {
+            skipSpace(p, end);
+            if (p == end) {
+                throw std::runtime_error("Unterminated attribute list.");
+            }
+            if (*p == ']') {
+                ++p;
+                return label;
+            }
+            TextSlice key = token(p, end);
+            skipSpace(p, end);
+            if (p == end || *p != '=') {
+                throw std::runtime_error("Malformed attribute list.");
+            }
+            ++p;
+            skipSpace(p, end);
+            TextSlice value = token(p, end);
+            if (is(key, "label")) label = value;
+        }
+    }
+
+    // Create every node, then link the edges in input order
+    Node<T, Summary>* build(size_t max_children) {
+        std::vector<Node<T, Summary>*> nodes;
+        nodes.reserve(labels.size());
+        try {
+            for (const TextSlice& label : labels) {
+                nodes.push_back(new Node<T, Summary>(ValueParser<T>::parse(label)));
+            }
+            for (const std::pair<size_t, size_t>& edge : edges) {
+                Node<T, Summary>* parent = nodes[edge.first];
+                Node<T, Summary>* child = nodes[edge.second];
+                if (child->parent || child == parent) {
+                    throw std::runtime_error("Input is not a tree: a node has two parents.");
+                }
+                if (parent->children.size() >= max_children) {
+                    throw std::runtime_error("Parent node not found or maximum children exceeded.");
+                }
+                parent->add_child(child);
+            }
+            Node<T, Summary>* root = nullptr;
+            for (Node<T, Summary>* node : nodes) {
+                if (node->parent) continue;
+                if (root) {
+                    throw std::runtime_error("Input is not a tree: it has more than one root.");
+                }
+                root = node;
+            }
+            if (!nodes.empty() && !root) {
+                throw std::runtime_error("Input is not a tree: it has no root.");
+            }
+            // With one root and one parent per node, only a detached cycle can hide nodes
+            size_t reachable = 0;
+            std::vector<Node<T, Summary>*> stack;
+            if (root) stack.push_back(root);
+            while (!stack.empty()) {
+                Node<T, Summary>* node = stack.back();
+                stack.pop_back();
+                ++reachable;
+                stack.insert(stack.end(), node->children.begin(), node->children.end());
+            }
+            if (reachable != nodes.size()) {
+                throw std::runtime_error("Input is not a tree: part of it is a cycle.");
+            }
+            return root;
+        } catch (...) {
+            for (Node<T, Summary>* node : nodes) {
+                delete node;
+            }
+            throw;
+        }
+    }
+};
+
+#endif // TREE_IMPORT_HPP
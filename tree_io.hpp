@@ -0,0 +1,455 @@
+// minnesav@gmail.com
+
+#ifndef TREE_IO_HPP
+#define TREE_IO_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+#include <type_traits>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "node.hpp"
+
+/*
+ * Binary tree file layout (all integers in host byte order, sections 8-byte aligned):
+ *
+ *   TreeFileHeader
+ *   child_count[n]               pre-order; uint8_t, or uint32_t when some node has more than 255 children
+ *   uint32_t subtree_size[n]     pre-order, lets a reader hop to the next sibling in O(1)
+ *   values                       fixed-size T: T[n]
+ *                                strings: uint64_t offset[n], then per node uint32_t length + bytes
+ */
+
+/**
+ * @brief Fixed-size header at the start of every binary tree file.
+ */
+struct TreeFileHeader {
+    char magic[4];  // "KTRE"
+    uint32_t version;
+    uint32_t byte_order;  // 0x01020304 as written by the producing host
+    uint32_t value_size;  // sizeof(T) for fixed-size values, 0 for length-prefixed strings
+    uint32_t value_kind;  // TREE_VALUE_* kind of T; a file only loads as a type of the same kind and size
+    uint32_t count_width;  // Bytes per child count: 1, or 4 when some node has more than 255 children
+    uint64_t node_count;
+    uint64_t max_children;  // Largest child count in the file
+};
+
+static const uint32_t TREE_FILE_VERSION = 2;
+static const uint32_t TREE_FILE_BYTE_ORDER = 0x01020304;
+
+// Value kinds stored in TreeFileHeader::value_kind, so that e.g. a float file does not load as int.
+// Types of the same kind and size (two structs of two doubles, say) cannot be told apart.
+static const uint32_t TREE_VALUE_INTEGER = 1;
+static const uint32_t TREE_VALUE_FLOAT = 2;
+static const uint32_t TREE_VALUE_ENUM = 3;
+static const uint32_t TREE_VALUE_RECORD = 4;  // Any other trivially copyable type
+static const uint32_t TREE_VALUE_STRING = 5;
+static const uint32_t TREE_VALUE_SIGNED = 0x100;  // Flag on the kinds above
+
+/**
+ * @brief The value kind of a trivially copyable T.
+ */
+template <typename T>
+struct TreeValueKindOf {
+    static const uint32_t value =
+        (std::is_integral<T>::value ? TREE_VALUE_INTEGER
+         : std::is_floating_point<T>::value ? TREE_VALUE_FLOAT
+         : std::is_enum<T>::value ? TREE_VALUE_ENUM
+         : TREE_VALUE_RECORD) |
+        (std::is_signed<T>::value ? TREE_VALUE_SIGNED : 0u);
+};
+
+/**
+ * @brief How node values are stored: trivially copyable types as a contiguous array.
+ *
+ * @tparam T The type of the values stored in the tree nodes.
+ */
+template <typename T, typename Enable = void>
+struct ValueCodec {
+    static_assert(std::is_trivially_copyable<T>::value, "Binary tree files need trivially copyable values or std::string.");
+    static_assert(alignof(T) <= 8, "Binary tree files align sections to 8 bytes.");
+
+    enum { value_size = sizeof(T) };
+    static const uint32_t value_kind = TreeValueKindOf<T>::value;
+
+    static void encode(const std::vector<const T*>& values, std::vector<char>& out) {
+        out.resize(values.size() * sizeof(T));
+        for (size_t i = 0; i < values.size(); ++i) {
+            std::memcpy(&out[i * sizeof(T)], values[i], sizeof(T));
+        }
+    }
+
+    // Value i of a mapped value section, read in place (the section size is checked when the file is opened)
+    static const T& view(const char* section, size_t, size_t i) {
+        return reinterpret_cast<const T*>(section)[i];
+    }
+};
+
+/**
+ * @brief Strings are stored length-prefixed, with an offset index for O(1) access.
+ */
+template <>
+struct ValueCodec<std::string> {
+    enum { value_size = 0 };
+    static const uint32_t value_kind = TREE_VALUE_STRING;
+
+    static void encode(const std::vector<const std::string*>& values, std::vector<char>& out) {
+        size_t index_bytes = values.size() * sizeof(uint64_t);
+        size_t total = index_bytes;
+        for (const std::string* value : values) {
+            total += sizeof(uint32_t) + value->size();
+        }
+        out.resize(total);
+        uint64_t offset = index_bytes;
+        for (size_t i = 0; i < values.size(); ++i) {
+            std::memcpy(&out[i * sizeof(uint64_t)], &offset, sizeof(offset));
+            uint32_t length = static_cast<uint32_t>(values[i]->size());
+            std::memcpy(&out[offset], &length, sizeof(length));
+            std::memcpy(&out[offset + sizeof(length)], values[i]->data(), length);
+            offset += sizeof(length) + length;
+        }
+    }
+
+    // Value i of a mapped value section of the given size; offsets and lengths are checked against it
+    static std::string view(const char* section, size_t bytes, size_t i) {
+        uint64_t offset;
+        std::memcpy(&offset, section + i * sizeof(uint64_t), sizeof(offset));
+        if (offset > bytes || bytes - offset < sizeof(uint32_t)) {
+            throw std::runtime_error("Binary tree file string offset is out of range.");
+        }
+        uint32_t length;
+        std::memcpy(&length, section + offset, sizeof(length));
+        if (bytes - offset - sizeof(length) < length) {
+            throw std::runtime_error("Binary tree file string length is out of range.");
+        }
+        return std::string(section + offset + sizeof(length), length);
+    }
+};
+
+/**
+ * @brief Writes the tree rooted at the given node to a binary tree file.
+ *
+ * @param root The root of the tree (may be nullptr for an empty file).
+ * @param path The file to create or overwrite.
+ */
+template <typename T, typename Summary>
+void save_tree(const Node<T, Summary>* root, const std::string& path) {
+    std::vector<uint32_t> counts;
+    std::vector<const T*> values;
+    std::vector<const Node<T, Summary>*> stack;
+    if (root) stack.push_back(root);
+    uint64_t max_children = 0;
+    while (!stack.empty()) {
+        const Node<T, Summary>* node = stack.back();
+        stack.pop_back();
+        if (node->children.size() > UINT32_MAX) {
+            throw std::runtime_error("Binary tree files support at most 2^32-1 children per node.");
+        }
+        counts.push_back(static_cast<uint32_t>(node->children.size()));
+        values.push_back(&node->value);
+        max_children = std::max<uint64_t>(max_children, node->children.size());
+        for (auto it = node->children.rbegin(); it != node->children.rend(); ++it) {
+            stack.push_back(*it);
+        }
+    }
+    if (counts.size() > UINT32_MAX) {
+        throw std::runtime_error("Binary tree files support at most 2^32-1 nodes.");
+    }
+
+    // Subtree sizes from the child counts, folded right to left
+    std::vector<uint32_t> sizes(counts.size());
+    std::vector<uint32_t> pending;
+    for (size_t i = counts.size(); i-- > 0;) {
+        uint32_t size = 1;
+        for (uint32_t c = 0; c < counts[i]; ++c) {
+            size += pending.back();
+            pending.pop_back();
+        }
+        sizes[i] = size;
+        pending.push_back(size);
+    }
+
+    std::vector<char> value_bytes;
+    ValueCodec<T>::encode(values, value_bytes);
+
+    TreeFileHeader header;
+    std::memcpy(header.magic, "KTRE", 4);
+    header.version = TREE_FILE_VERSION;
+    header.byte_order = TREE_FILE_BYTE_ORDER;
+    header.value_size = ValueCodec<T>::value_size;
+    header.value_kind = ValueCodec<T>::value_kind;
+    header.count_width = max_children > 255 ? sizeof(uint32_t) : sizeof(uint8_t);
+    header.node_count = counts.size();
+    header.max_children = max_children;
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        throw std::runtime_error("Could not open file to write binary tree.");
+    }
+    const char padding[8] = {0};
+    size_t written = 0;
+    auto section = [&](const void* data, size_t length) {
+        file.write(static_cast<const char*>(data), static_cast<std::streamsize>(length));
+        written += length;
+        size_t pad = (8 - written % 8) % 8;
+        file.write(padding, static_cast<std::streamsize>(pad));
+        written += pad;
+    };
+    section(&header, sizeof(header));
+    if (header.count_width == sizeof(uint8_t)) {
+        std::vector<uint8_t> narrow(counts.begin(), counts.end());
+        section(narrow.data(), narrow.size());
+    } else {
+        section(counts.data(), counts.size() * sizeof(uint32_t));
+    }
+    section(sizes.data(), sizes.size() * sizeof(uint32_t));
+    section(value_bytes.data(), value_bytes.size());
+    if (!file) {
+        throw std::runtime_error("Could not write binary tree.");
+    }
+}
+
+/**
+ * @brief A whole file mapped read-only into memory.
+ */
+class MappedFile {
+public:
+    /**
+     * @brief Maps the given file (an empty file maps to an empty range).
+     *
+     * @param path The file to map.
+     */
+    explicit MappedFile(const std::string& path) : data(nullptr), length(0) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("Could not open " + path + ".");
+        }
+        struct stat info;
+        if (::fstat(fd, &info) != 0) {
+            ::close(fd);
+            throw std::runtime_error("Could not read " + path + ".");
+        }
+        length = static_cast<size_t>(info.st_size);
+        if (length) {
+            void* mapping = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapping == MAP_FAILED) {
+                ::close(fd);
+                throw std::runtime_error("Could not map " + path + ".");
+            }
+            data = static_cast<const char*>(mapping);
+            ::madvise(mapping, length, MADV_SEQUENTIAL);
+        }
+        ::close(fd);
+    }
+
+    ~MappedFile() {
+        if (data) ::munmap(const_cast<char*>(data), length);
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* begin() const { return data; }
+    const char* end() const { return data + length; }
+    size_t size() const { return length; }
+
+private:
+    const char* data;
+    size_t length;
+};
+
+/**
+ * @brief Read-only, zero-copy view of a binary tree file mapped into memory.
+ *
+ * Nodes are addressed by their pre-order index (the root is 0, and a plain index
+ * loop is a pre-order traversal). Nothing is deserialised: structure and fixed-size
+ * values are read straight from the mapping.
+ *
+ * @tparam T The type of the values stored in the tree nodes.
+ */
+template <typename T>
+class MappedTreeView {
+public:
+    /**
+     * @brief Maps the given file and validates its header.
+     *
+     * @param path The binary tree file to map.
+     */
+    explicit MappedTreeView(const std::string& path) : file(path), data(file.begin()), length(file.size()) {
+        if (length < sizeof(TreeFileHeader)) {
+            throw std::runtime_error("Binary tree file is truncated.");
+        }
+        validate();
+    }
+
+    /**
+     * @brief Number of nodes in the tree.
+     */
+    size_t size() const {
+        return static_cast<size_t>(header().node_count);
+    }
+
+    /**
+     * @brief Largest number of children of any node in the file.
+     */
+    size_t max_children() const {
+        return static_cast<size_t>(header().max_children);
+    }
+
+    /**
+     * @brief Number of children of node i.
+     */
+    size_t child_count(size_t i) const {
+        if (count_width == sizeof(uint8_t)) return static_cast<uint8_t>(counts[i]);
+        return reinterpret_cast<const uint32_t*>(counts)[i];
+    }
+
+    /**
+     * @brief Number of nodes in the subtree rooted at node i.
+     */
+    size_t subtree_size(size_t i) const {
+        return sizes[i];
+    }
+
+    /**
+     * @brief Index of the k-th child of node i, hopping over earlier siblings' subtrees.
+     */
+    size_t child(size_t i, size_t k) const {
+        size_t index = i + 1;
+        for (size_t c = 0; c < k; ++c) {
+            if (index >= size() || sizes[index] == 0) {
+                throw std::runtime_error("Binary tree file structure is corrupt.");
+            }
+            index += sizes[index];
+        }
+        if (index >= size()) {
+            throw std::runtime_error("Binary tree file structure is corrupt.");
+        }
+        return index;
+    }
+
+    /**
+     * @brief Value of node i, read in place (strings are copied out).
+     */
+    auto value(size_t i) const -> decltype(ValueCodec<T>::view(nullptr, 0, 0)) {
+        return ValueCodec<T>::view(values, value_bytes, i);
+    }
+
+private:
+    MappedFile file;
+    const char* data;
+    size_t length;
+    const char* counts;
+    size_t count_width;  // Bytes per child count
+    const uint32_t* sizes;
+    const char* values;
+    size_t value_bytes;  // Bytes from the value section to the end of the file
+
+    const TreeFileHeader& header() const {
+        return *reinterpret_cast<const TreeFileHeader*>(data);
+    }
+
+    static size_t aligned(size_t offset) {
+        return (offset + 7) / 8 * 8;
+    }
+
+    void validate() {
+        const TreeFileHeader& head = header();
+        if (std::memcmp(head.magic, "KTRE", 4) != 0) {
+            throw std::runtime_error("Not a binary tree file.");
+        }
+        if (head.version != TREE_FILE_VERSION) {
+            throw std::runtime_error("Unsupported binary tree file version.");
+        }
+        if (head.byte_order != TREE_FILE_BYTE_ORDER) {
+            throw std::runtime_error("Binary tree file was written with a different byte order.");
+        }
+        if (head.value_size != ValueCodec<T>::value_size || head.value_kind != ValueCodec<T>::value_kind) {
+            throw std::runtime_error("Binary tree file holds a different value type.");
+        }
+        if (head.count_width != sizeof(uint8_t) && head.count_width != sizeof(uint32_t)) {
+            throw std::runtime_error("Binary tree file structure is corrupt.");
+        }
+        if (head.node_count > length) {
+            throw std::runtime_error("Binary tree file is truncated.");  // Every node takes at least a byte
+        }
+        size_t n = static_cast<size_t>(head.node_count);
+        size_t counts_at = aligned(sizeof(TreeFileHeader));
+        size_t sizes_at = aligned(counts_at + n * head.count_width);
+        size_t values_at = aligned(sizes_at + n * sizeof(uint32_t));
+        size_t record_bytes = ValueCodec<T>::value_size != 0 ? size_t(ValueCodec<T>::value_size) : sizeof(uint64_t);
+        if (values_at + n * record_bytes > length) {
+            throw std::runtime_error("Binary tree file is truncated.");
+        }
+        counts = data + counts_at;
+        count_width = head.count_width;
+        sizes = reinterpret_cast<const uint32_t*>(data + sizes_at);
+        values = data + values_at;
+        value_bytes = length - values_at;
+        if (n && sizes[0] != n) {
+            throw std::runtime_error("Binary tree file structure is corrupt.");
+        }
+    }
+};
+
+/**
+ * @brief Builds fresh nodes from a binary tree file in one pre-order pass.
+ *
+ * Throws on a file whose structure does not describe exactly one tree of
+ * node_count nodes; the nodes built so far are freed first.
+ *
+ * @param path The binary tree file to read.
+ * @param max_children The arity limit of the receiving tree.
+ * @return Node<T, Summary>* The new root (nullptr for an empty file); the caller owns the nodes.
+ */
+template <typename T, typename Summary = StructuralSummary>
+Node<T, Summary>* load_tree(const std::string& path, size_t max_children) {
+    MappedTreeView<T> view(path);
+    if (view.max_children() > max_children) {
+        throw std::runtime_error("Binary tree file exceeds the maximum number of children.");
+    }
+    Node<T, Summary>* root = nullptr;
+    std::vector<std::pair<Node<T, Summary>*, size_t>> open;  // Nodes still waiting for children
+    try {
+        for (size_t i = 0; i < view.size(); ++i) {
+            if ((open.empty() && root) || view.child_count(i) > max_children) {
+                throw std::runtime_error("Binary tree file structure is corrupt.");
+            }
+            Node<T, Summary>* node = new Node<T, Summary>(view.value(i));
+            if (open.empty()) {
+                root = node;
+            } else {
+                open.back().first->add_child(node);
+                if (--open.back().second == 0) open.pop_back();
+            }
+            if (view.child_count(i)) {
+                open.push_back(std::make_pair(node, view.child_count(i)));
+            }
+        }
+        if (!open.empty()) {
+            throw std::runtime_error("Binary tree file structure is truncated.");  // Children promised but missing
+        }
+    } catch (...) {
+        // Every node built so far is linked under root, so freeing that tree frees them all
+        std::vector<Node<T, Summary>*> stack;
+        if (root) stack.push_back(root);
+        while (!stack.empty()) {
+            Node<T, Summary>* node = stack.back();
+            stack.pop_back();
+            stack.insert(stack.end(), node->children.begin(), node->children.end());
+            delete node;
+        }
+        throw;
+    }
+    return root;
+}
+
+#endif // TREE_IO_HPP
@@ -0,0 +1,255 @@
+// minnesav@gmail.com
+
+#ifndef TREE_LAYOUT_HPP
+#define TREE_LAYOUT_HPP
+
+#include <vector>
+#include <stack>
+#include <algorithm>
+#include "node.hpp"
+
+/**
+ * @brief Linear-time tidy tree layout (Buchheim, Jünger & Leipert's improvement of Walker).
+ *
+ * Assigns every node an x coordinate in sibling-spacing units and a y coordinate equal
+ * to its depth, so that subtrees never overlap and parents are centred over their
+ * children. All passes are iterative, so deep chains do not exhaust the call stack.
+ *
+ * @tparam T The type of the values stored in the tree nodes.
+ * @tparam Summary The summary policy of the nodes (see summary.hpp).
+ */
+template <typename T, typename Summary = StructuralSummary>
+class TreeLayout {
+public:
+    /**
+     * @brief Position of one node after layout.
+     */
+    struct Placement {
+        const Node<T, Summary>* node;
+        double x;  // Horizontal position, in units of the minimum sibling distance
+        size_t depth;  // Level of the node (the root is level 0)
+        size_t parent;  // Index of the parent placement, or size_t(-1) for the root
+    };
+
+    /**
+     * @brief Computes the layout for the tree rooted at the given node in O(n).
+     *
+     * @param root The root of the tree (may be nullptr).
+     * @return std::vector<Placement> One placement per node, in pre-order; x starts at 0.
+     */
+    std::vector<Placement> compute(const Node<T, Summary>* root) {
+        items.clear();
+        if (!root) return std::vector<Placement>();
+        index(root);
+
+        firstWalk();
+
+        // Second walk (pre-order): accumulate modifiers into final x
+        std::vector<Placement> result(items.size());
+        std::vector<double> mod_sum(items.size(), 0.0);
+        double min_x = 0.0;
+        for (size_t i = 0; i < items.size(); ++i) {
+            double above = items[i].parent == none ? 0.0 : mod_sum[items[i].parent];
+            result[i] = Placement{items[i].node, items[i].prelim + above, items[i].depth, items[i].parent};
+            mod_sum[i] = above + items[i].mod;
+            min_x = std::min(min_x, result[i].x);
+        }
+        for (Placement& placement : result) {
+            placement.x -= min_x;
+        }
+        return result;
+    }
+
+private:
+    static const size_t none = size_t(-1);
+
+    // Per-node working state, indexed in pre-order
+    struct Item {
+        const Node<T, Summary>* node;
+        size_t parent;
+        size_t depth;
+        size_t number;  // Position among siblings
+        size_t first_kid;  // Offset of the children in `kids`
+        size_t kid_count;
+        double prelim;
+        double mod;
+        double change;
+        double shift;
+        size_t thread;
+        size_t ancestor;
+    };
+
+    std::vector<Item> items;
+    std::vector<size_t> kids;  // Children of every item, grouped per parent (CSR layout)
+
+    // Number the nodes in pre-order and lay their child lists out contiguously
+    void index(const Node<T, Summary>* root) {
+        struct Frame { const Node<T, Summary>* node; size_t parent; };
+        std::stack<Frame, std::vector<Frame>> stack;
+        stack.push(Frame{root, none});
+        size_t offset = 0;
+        while (!stack.empty()) {
+            Frame frame = stack.top();
+            stack.pop();
+            size_t id = items.size();
+            size_t depth = frame.parent == none ? 0 : items[frame.parent].depth + 1;
+            size_t number = 0;
+            if (frame.parent != none) {
+                number = items[frame.parent].kid_count++;
+            }
+            items.push_back(Item{frame.node, frame.parent, depth, number, offset, 0,
+                                 0.0, 0.0, 0.0, 0.0, none, id});
+            const std::vector<Node<T, Summary>*>& children = frame.node->children;
+            for (size_t c = children.size(); c-- > 0;) {
+                if (children[c]) {
+                    stack.push(Frame{children[c], id});
+                    ++offset;
+                }
+            }
+        }
+        kids.assign(offset, 0);
+        for (size_t id = 1; id < items.size(); ++id) {
+            const Item& item = items[id];
+            kids[items[item.parent].first_kid + item.number] = id;
+        }
+    }
+
+    size_t kid(size_t v, size_t c) const {
+        return kids[items[v].first_kid + c];
+    }
+
+    size_t firstKid(size_t v) const {
+        return kids[items[v].first_kid];
+    }
+
+    size_t lastKid(size_t v) const {
+        return kids[items[v].first_kid + items[v].kid_count - 1];
+    }
+
+    size_t leftSibling(size_t v) const {
+        const Item& item = items[v];
+        return item.number == 0 ? none : kid(item.parent, item.number - 1);
+    }
+
+    size_t leftmostSibling(size_t v) const {
+        const Item& item = items[v];
+        return item.number == 0 ? none : firstKid(item.parent);
+    }
+
+    size_t nextLeft(size_t v) const {
+        return items[v].kid_count == 0 ? items[v].thread : firstKid(v);
+    }
+
+    size_t nextRight(size_t v) const {
+        return items[v].kid_count == 0 ? items[v].thread : lastKid(v);
+    }
+
+    // First walk (post-order, children left to right): preliminary x and modifiers.
+    // Each child is apportioned against its left siblings as soon as its subtree is done.
+    void firstWalk() {
+        struct Walk { size_t node; size_t next; size_t default_ancestor; };
+        std::vector<Walk> stack;
+        stack.push_back(Walk{0, 0, none});
+        while (!stack.empty()) {
+            Walk& top = stack.back();
+            if (top.next < items[top.node].kid_count) {
+                size_t next = kid(top.node, top.next++);
+                stack.push_back(Walk{next, 0, none});
+                continue;
+            }
+            size_t finished = top.node;
+            placeNode(finished);
+            stack.pop_back();
+            if (!stack.empty()) {
+                Walk& parent = stack.back();
+                if (parent.default_ancestor == none) {
+                    parent.default_ancestor = firstKid(parent.node);
+                }
+                apportion(finished, parent.default_ancestor);
+            }
+        }
+    }
+
+    // Preliminary x of a node whose children are all placed and apportioned
+    void placeNode(size_t v) {
+        Item& item = items[v];
+        size_t left = leftSibling(v);
+        if (item.kid_count == 0) {
+            item.prelim = left == none ? 0.0 : items[left].prelim + 1.0;
+            return;
+        }
+        executeShifts(v);
+        double midpoint = (items[firstKid(v)].prelim + items[lastKid(v)].prelim) / 2.0;
+        if (left != none) {
+            item.prelim = items[left].prelim + 1.0;
+            item.mod = item.prelim - midpoint;
+        } else {
+            item.prelim = midpoint;
+        }
+    }
+
+    void apportion(size_t v, size_t& default_ancestor) {
+        size_t w = leftSibling(v);
+        if (w == none) return;
+        size_t vip = v, vop = v;  // Inner and outer contour on the right
+        size_t vim = w, vom = leftmostSibling(v);  // Inner and outer contour on the left
+        double sip = items[vip].mod, sop = items[vop].mod;
+        double sim = items[vim].mod, som = items[vom].mod;
+        while (nextRight(vim) != none && nextLeft(vip) != none) {
+            vim = nextRight(vim);
+            vip = nextLeft(vip);
+            vom = nextLeft(vom);
+            vop = nextRight(vop);
+            items[vop].ancestor = v;
+            double shift = (items[vim].prelim + sim) - (items[vip].prelim + sip) + 1.0;
+            if (shift > 0) {
+                moveSubtree(ancestorOf(vim, v, default_ancestor), v, shift);
+                sip += shift;
+                sop += shift;
+            }
+            sim += items[vim].mod;
+            sip += items[vip].mod;
+            som += items[vom].mod;
+            sop += items[vop].mod;
+        }
+        if (nextRight(vim) != none && nextRight(vop) == none) {
+            items[vop].thread = nextRight(vim);
+            items[vop].mod += sim - sop;
+        }
+        if (nextLeft(vip) != none && nextLeft(vom) == none) {
+            items[vom].thread = nextLeft(vip);
+            items[vom].mod += sip - som;
+            default_ancestor = v;
+        }
+    }
+
+    void moveSubtree(size_t wm, size_t wp, double shift) {
+        double subtrees = static_cast<double>(items[wp].number - items[wm].number);
+        items[wp].change -= shift / subtrees;
+        items[wp].shift += shift;
+        items[wm].change += shift / subtrees;
+        items[wp].prelim += shift;
+        items[wp].mod += shift;
+    }
+
+    void executeShifts(size_t v) {
+        double shift = 0.0, change = 0.0;
+        for (size_t c = items[v].kid_count; c-- > 0;) {
+            Item& w = items[kid(v, c)];
+            w.prelim += shift;
+            w.mod += shift;
+            change += w.change;
+            shift += w.shift + change;
+        }
+    }
+
+    size_t ancestorOf(size_t vim, size_t v, size_t default_ancestor) const {
+        size_t candidate = items[vim].ancestor;
+        return items[candidate].parent == items[v].parent ? candidate : default_ancestor;
+    }
+};
+
+template <typename T, typename Summary>
+const size_t TreeLayout<T, Summary>::none;
+
+#endif // TREE_LAYOUT_HPP
@@ -7,14 +7,20 @@
 #include <fstream>
 #include <string>
 #include <queue>
+#include <stdexcept>
 #include "node.hpp"
+#include "dot_writer.hpp"
+#include "svg_writer.hpp"
+#include "render_queue.hpp"
 
 // Forward declaration of Tree template class
-template <typename T, int K>
+template <typename T, int K, typename Instrumentation, typename Summary>
 class Tree;
 
 /**
  * @brief A class for printing the tree structure to a DOT file and generating a PNG image.
+ *
+ * PNG rendering runs asynchronously on the shared RenderQueue; call flush() to wait for it.
  * 
  * @tparam T The type of the values stored in the tree nodes.
  * @tparam K The maximum number of children each node can have.
@@ -23,48 +29,77 @@ template <typename T, int K>
 class TreePrinter {
 public:
     /**
-     * @brief Prints the tree structure to a DOT file and generates a PNG image.
+     * @brief Constructs a printer that renders PNG images after writing DOT files.
+     */
+    TreePrinter() : dot_only(false) {}
+
+    /**
+     * @brief Prints the tree structure to a DOT file and queues the PNG rendering.
+     *
+     * Returns as soon as the DOT file is written; the Graphviz run happens on a
+     * background worker (see flush()). In DOT-only mode no rendering is queued.
      * 
      * @param tree The tree to be printed.
      * @param dot_filename The filename for the DOT file.
      * @param png_filename The filename for the PNG file.
+     * @param options Level-of-detail limits; by default the whole tree is drawn.
      */
-    void print(Tree<T, K> &tree, const std::string &dot_filename, const std::string &png_filename) {
-        std::ofstream file(dot_filename);
-        if (!file.is_open()) {
-            throw std::runtime_error("Could not open file to write DOT representation.");
-        }
+    template <typename Instrumentation, typename Summary>
+    void print(Tree<T, K, Instrumentation, Summary> &tree, const std::string &dot_filename, const std::string &png_filename,
+               const RenderOptions &options = RenderOptions()) {
+        write_dot(tree, dot_filename, options);
+        if (dot_only) return;
 
-        file << "digraph G {\n";
-        file << "node [shape=circle];\n";
+        std::string command = "dot -Tpng " + dot_filename + " -o " + png_filename;
+        RenderQueue::instance().submit(command);
+    }
 
-        Node<T>* root = tree.getRoot();
-        if (root) {
-            printNode(file, root);
-        }
+    /**
+     * @brief Enables or disables DOT-only mode, which skips PNG rendering entirely.
+     *
+     * @param enabled True to only write DOT files.
+     */
+    void set_dot_only(bool enabled) {
+        dot_only = enabled;
+    }
 
-        file << "}\n";
-        file.close();
+    /**
+     * @brief Blocks until every queued PNG rendering (from any printer) has finished.
+     */
+    void flush() {
+        RenderQueue::instance().flush();
+    }
 
-        std::string command = "dot -Tpng " + dot_filename + " -o " + png_filename;
-        system(command.c_str());
+    /**
+     * @brief Writes the tree structure to a DOT file without rendering it.
+     *
+     * Nodes are identified by their pre-order index and labelled with their value,
+     * so duplicate values remain separate nodes.
+     *
+     * @param tree The tree to be written.
+     * @param dot_filename The filename for the DOT file.
+     * @param options Level-of-detail limits; by default the whole tree is written.
+     */
+    template <typename Instrumentation, typename Summary>
+    void write_dot(Tree<T, K, Instrumentation, Summary> &tree, const std::string &dot_filename, const RenderOptions &options = RenderOptions()) {
+        DotWriter<T, Summary> writer(dot_filename);
+        writer.write(tree.getRoot(), options);
     }
 
-private:
     /**
-     * @brief Recursively prints nodes and their children to the DOT file.
-     * 
-     * @param file The output file stream for the DOT file.
-     * @param node The current node to print.
+     * @brief Draws the tree to an SVG file with the built-in O(n) layout, without Graphviz.
+     *
+     * @param tree The tree to be drawn.
+     * @param svg_filename The filename for the SVG file.
      */
-    void printNode(std::ofstream &file, Node<T>* node) {
-        for (Node<T>* child : node->children) {
-            if (child) {
-                file << "\"" << node->get_value() << "\" -> \"" << child->get_value() << "\";\n";
-                printNode(file, child);
-            }
-        }
+    template <typename Instrumentation, typename Summary>
+    void print_svg(Tree<T, K, Instrumentation, Summary> &tree, const std::string &svg_filename) {
+        SvgWriter<T, Summary> writer(svg_filename);
+        writer.write(tree.getRoot());
     }
+
+private:
+    bool dot_only;  // Skip the PNG rendering step
 };
 
 #endif // TREE_PRINTER_HPP